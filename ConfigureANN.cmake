@@ -27,7 +27,7 @@ ENDIF(ANN_INCLUDE_DIR)
 IF(ANN_FOUND)
   INCLUDE_DIRECTORIES(${ANN_INCLUDE_DIR})
 ELSE(ANN_FOUND)
-  MESSAGE("PROBLEM: ANN not found.")
+  MESSAGE("ANN not found. Only the built-in kd tree will be available.")
 ENDIF(ANN_FOUND)
 
 MARK_AS_ADVANCED(ANN_INCLUDE_DIR
@@ -0,0 +1,50 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef BINARYMESH_H
+#define BINARYMESH_H
+
+#include <stdint.h>
+
+//! Binary triangle mesh file (.bmsh), written by FileWriter and memory mapped by FileLoader.
+//! The file consists of the header followed by the vertex block (3 coordinates per vertex, float64 or float32), 
+//! the triangle block (3 uint32 vertex indices per triangle) and the optional color block (3 values per vertex, same type as the vertices).
+//! All values are little-endian, every block starts at the 8 byte aligned offset given in the header.
+struct BinaryMeshHeader
+{
+	char magic[4];
+	uint32_t version;
+
+	//Combination of the BinaryMeshFlags
+	uint32_t flags;
+	uint32_t reserved;
+
+	uint64_t numVertices;
+	uint64_t numTriangles;
+
+	//Byte offsets of the blocks from the start of the file, colorOffset is 0 without colors
+	uint64_t vertexOffset;
+	uint64_t triangleOffset;
+	uint64_t colorOffset;
+};
+
+enum BinaryMeshFlags
+{
+	BINARY_MESH_FLOAT32 = 1,
+	BINARY_MESH_COLORS = 2
+};
+
+const char BINARY_MESH_MAGIC[4] = {'B', 'M', 'S', 'H'};
+const uint32_t BINARY_MESH_VERSION = 1;
+
+#endif
\ No newline at end of file
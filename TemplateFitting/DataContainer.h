@@ -17,6 +17,7 @@
 #include <stdlib.h>
 #include <vector>
 #include <string>
+#include <utility>
 
 template<typename DataType, size_t CoordsDim, typename TextureType, size_t TextureDim>
 class ImportMesh
@@ -29,8 +30,26 @@ public:
 	}
 
 	ImportMesh(const ImportMesh& mesh)
+	: m_vertexList(mesh.m_vertexList)
+	, m_triangleList(mesh.m_triangleList)
+	, m_vertexColorList(mesh.m_vertexColorList)
+	, m_textureList(mesh.m_textureList)
+	, m_textureIndexList(mesh.m_textureIndexList)
+	, m_sstrTextureName(mesh.m_sstrTextureName)
 	{
-		*this = mesh;
+
+	}
+
+	//! Takes over the data of mesh without copying, mesh is left empty
+	ImportMesh(ImportMesh&& mesh)
+	: m_vertexList(std::move(mesh.m_vertexList))
+	, m_triangleList(std::move(mesh.m_triangleList))
+	, m_vertexColorList(std::move(mesh.m_vertexColorList))
+	, m_textureList(std::move(mesh.m_textureList))
+	, m_textureIndexList(std::move(mesh.m_textureIndexList))
+	, m_sstrTextureName(std::move(mesh.m_sstrTextureName))
+	{
+		mesh.clear();
 	}
 
 	~ImportMesh()
@@ -40,15 +59,32 @@ public:
 
 	ImportMesh& operator=(const ImportMesh& mesh)
 	{
-		clear();
+		//Assigning the vectors reuses the allocated memory of this mesh
+		m_vertexList = mesh.m_vertexList;
+		m_triangleList = mesh.m_triangleList;
+		m_vertexColorList = mesh.m_vertexColorList;
+
+		m_textureList = mesh.m_textureList;
+		m_textureIndexList = mesh.m_textureIndexList;
+		m_sstrTextureName = mesh.m_sstrTextureName;
+		return *this;
+	}
 
-		m_vertexList = mesh.getVertexList();
-		m_vertexIndexList = mesh.getVertexIndexList();
-		m_vertexColorList = mesh.getVertexColorList();
+	//! Takes over the data of mesh without copying, mesh is left empty
+	ImportMesh& operator=(ImportMesh&& mesh)
+	{
+		if(this != &mesh)
+		{
+			m_vertexList = std::move(mesh.m_vertexList);
+			m_triangleList = std::move(mesh.m_triangleList);
+			m_vertexColorList = std::move(mesh.m_vertexColorList);
+
+			m_textureList = std::move(mesh.m_textureList);
+			m_textureIndexList = std::move(mesh.m_textureIndexList);
+			m_sstrTextureName = std::move(mesh.m_sstrTextureName);
+			mesh.clear();
+		}
 
-		m_textureList = mesh.getTextureList();
-		m_textureIndexList = mesh.getTextureIndexList();
-		m_sstrTextureName = mesh.getTextureName();
 		return *this;
 	}
 
@@ -61,7 +97,7 @@ public:
 	virtual void clearVertexData()
 	{
 		m_vertexList.clear();
-		m_vertexIndexList.clear();
+		m_triangleList.clear();
 		clearVertexColorList();
 	}
 
@@ -84,7 +120,7 @@ public:
 
 	size_t getNumFaces() const
 	{
-		return m_vertexIndexList.size();
+		return m_triangleList.size()/3;
 	}
 
 	const std::vector<DataType>& getVertexList() const
@@ -92,37 +128,50 @@ public:
 		return m_vertexList;
 	}
 
-	std::vector<DataType> getVertexList()
+	//! Mutable view of the vertex list for in-place modifications, the size has to stay a multiple of CoordsDim
+	std::vector<DataType>& getMutableVertexList()
 	{
 		return m_vertexList;
 	}
 
-	const std::vector<std::vector<int>>& getVertexIndexList() const
+	//! Vertex indices of all triangles, triangle i is given by the entries 3*i, 3*i+1 and 3*i+2
+	const std::vector<int>& getTriangleList() const
 	{
-		return m_vertexIndexList;
+		return m_triangleList;
 	}
 
-	std::vector<std::vector<int>> getVertexIndexList()
+	//! Mutable view of the triangle list for in-place modifications, the size has to stay a multiple of 3
+	std::vector<int>& getMutableTriangleList()
 	{
-		return m_vertexIndexList;
+		return m_triangleList;
 	}
 
-	const std::vector<double>& getVertexColorList() const
+	//! Compatibility accessor, builds one index list per triangle from the triangle list
+	std::vector<std::vector<int>> getVertexIndexList() const
 	{
-		return m_vertexColorList;
+		const size_t numFaces = getNumFaces();
+
+		std::vector<std::vector<int>> vertexIndexList(numFaces);
+		for(size_t i = 0; i < numFaces; ++i)
+		{
+			vertexIndexList[i].assign(m_triangleList.begin()+3*i, m_triangleList.begin()+3*i+3);
+		}
+
+		return vertexIndexList;
 	}
 
-	std::vector<double> getVertexColorList()
+	const std::vector<double>& getVertexColorList() const
 	{
 		return m_vertexColorList;
 	}
 
-	const std::vector<TextureType>& getTextureList() const
+	//! Mutable view of the vertex colors for in-place modifications
+	std::vector<double>& getMutableVertexColorList()
 	{
-		return m_textureList;
+		return m_vertexColorList;
 	}
 
-	std::vector<TextureType> getTextureList()
+	const std::vector<TextureType>& getTextureList() const
 	{
 		return m_textureList;
 	}
@@ -132,11 +181,6 @@ public:
 		return m_textureIndexList;
 	}
 
-	std::vector<std::vector<int>> getTextureIndexList()
-	{
-		return m_textureIndexList;
-	}
-
 	const std::string& getTextureName() const
 	{
 		return m_sstrTextureName;
@@ -149,23 +193,72 @@ public:
 			return false;
 		}
 
-		m_vertexList.clear();
 		m_vertexList = vertexList;
 		return true;
 	}
 
+	//! Takes over vertexList without copying
+	virtual bool setVertexList(std::vector<DataType>&& vertexList)
+	{
+		if(vertexList.size() % CoordsDim != 0)
+		{
+			return false;
+		}
+
+		m_vertexList = std::move(vertexList);
+		return true;
+	}
+
+	virtual bool setTriangleList(const std::vector<int>& triangleList)
+	{
+		if(triangleList.size() % 3 != 0)
+		{
+			return false;
+		}
+
+		m_triangleList = triangleList;
+		return true;
+	}
+
+	//! Takes over triangleList without copying
+	virtual bool setTriangleList(std::vector<int>&& triangleList)
+	{
+		if(triangleList.size() % 3 != 0)
+		{
+			return false;
+		}
+
+		m_triangleList = std::move(triangleList);
+		return true;
+	}
+
+	//! Compatibility setter, polygons are split into a triangle fan and faces with less than 3 vertices are skipped
 	virtual void setVertexIndexList(const std::vector<std::vector<int>>& vertexIndexList)
 	{
-		m_vertexIndexList.clear();
-		m_vertexIndexList = vertexIndexList;
+		m_triangleList.clear();
+		for(size_t i = 0; i < vertexIndexList.size(); ++i)
+		{
+			const std::vector<int>& currPolyIndices = vertexIndexList[i];
+			for(size_t j = 2; j < currPolyIndices.size(); ++j)
+			{
+				m_triangleList.push_back(currPolyIndices[0]);
+				m_triangleList.push_back(currPolyIndices[j-1]);
+				m_triangleList.push_back(currPolyIndices[j]);
+			}
+		}
 	}
 
 	virtual void setVertexColorList(const std::vector<double>& vertexColorList)
 	{
-		m_vertexColorList.clear();
 		m_vertexColorList = vertexColorList;
 	}
 
+	//! Takes over vertexColorList without copying
+	virtual void setVertexColorList(std::vector<double>&& vertexColorList)
+	{
+		m_vertexColorList = std::move(vertexColorList);
+	}
+
 	virtual bool setTextureList(const std::vector<TextureType>& textureList)
 	{
 		if(textureList.size() % TextureDim != 0)
@@ -173,27 +266,36 @@ public:
 			return false;
 		}
 
-		m_textureList.clear();
 		m_textureList = textureList;
 		return true;
 	}
 
+	//! Texture polygons are split into the same triangle fans as the polygons passed to setVertexIndexList, such that texture triangle i belongs to triangle i
 	virtual void setTextureIndexList(const std::vector<std::vector<int>>& textureIndexList)
 	{
 		m_textureIndexList.clear();
-		m_textureIndexList = textureIndexList;
+		for(size_t i = 0; i < textureIndexList.size(); ++i)
+		{
+			const std::vector<int>& currPolyIndices = textureIndexList[i];
+			for(size_t j = 2; j < currPolyIndices.size(); ++j)
+			{
+				const int triangleIndices[3] = {currPolyIndices[0], currPolyIndices[j-1], currPolyIndices[j]};
+				m_textureIndexList.push_back(std::vector<int>(triangleIndices, triangleIndices+3));
+			}
+		}
 	}
 
 	virtual void setTextureName(const std::string& sstrTextureName)
 	{
-		m_sstrTextureName.clear();
 		m_sstrTextureName = sstrTextureName;
 	}
 
 private:
 	//Vertex data
 	std::vector<DataType> m_vertexList;
-	std::vector<std::vector<int>> m_vertexIndexList;
+
+	//Faces are stored as one contiguous list of 3 vertex indices per triangle
+	std::vector<int> m_triangleList;
 	std::vector<double> m_vertexColorList;
 
 	//Texture data
@@ -28,13 +28,80 @@ const double RIGID_WEIGHT = 1000.0;
 //Maximum number of iterations 
 const size_t MAX_NUM_ITER = 10;
 
+//The iterations stop before MAX_NUM_ITER once all of the following values of an iteration at full template resolution are below their thresholds (a threshold of 0 always runs MAX_NUM_ITER iterations)
+//Default thresholds, set at run time by the FitOptions convergenceCorrespondenceChange, convergenceEnergyDecrease and convergenceMaxDisplacement
+//Fraction of template vertices whose correspondence changed compared to the previous iteration
+const double CONVERGENCE_CORRESPONDENCE_CHANGE = 0.01;
+
+//Relative decrease of the energy during the minimization of the iteration
+const double CONVERGENCE_ENERGY_DECREASE = 0.02;
+
+//Maximum displacement of a template vertex during the iteration
+const double CONVERGENCE_MAX_DISPLACEMENT = 1.0;
+
+//Number of coarser template levels fitted before the template itself (0 disables the coarse-to-fine fitting)
+//Each level clusters the vertices of the next finer level with their 1-ring neighbors, the transformations are passed on from coarse to fine
+const size_t NUM_COARSE_LEVELS = 0;
+
+//Number of the last iterations fitted at full template resolution, the remaining iterations are distributed over the coarse levels
+const size_t NUM_FULL_RESOLUTION_ITER = 3;
+
+//Minimum number of vertices of a coarse template level
+const size_t MIN_NUM_LEVEL_VERTICES = 200;
+
+//Store the cleaned template and its pre-computed fitting data in a binary cache file next to the template (<template file>.cache)
+//The cache is used if it matches the content of the template file and the hierarchy settings, otherwise it is rewritten
+const bool USE_TEMPLATE_CACHE = true;
+
 //Maximum valid distance of a template vertex to its nearest neighbor
 const double MAX_NN_DIST = 15.0;
 
 //Maximum valid angle between a template vertex and its nearest neighbor
 const double MAX_ANGLE = 80.0;
 
+//Use the closest point on the target surface as correspondence instead of the projection into the tangent plane of the nearest target vertex
+const bool USE_SURFACE_CORRESPONDENCES = false;
+
+//Use the ANN kd tree instead of the built-in kd tree for the nearest neighbor search (requires compilation with USE_ANN)
+const bool USE_ANN_KDTREE = false;
+
+//Reuse the nearest neighbors of the previous iteration instead of querying the kd tree for every template vertex (not used with USE_SURFACE_CORRESPONDENCES)
+//A vertex that moved at most COHERENT_SEARCH_RATIO times its previous nearest neighbor distance walks over the target vertex adjacency starting at its previous nearest neighbor
+const bool USE_COHERENT_SEARCH = false;
+
+const double COHERENT_SEARCH_RATIO = 0.5;
+
+//Minimizer of the fitting energy in each iteration
+//SOLVER_LBFGSB: quasi-Newton minimization with vnl_lbfgsb
+//SOLVER_GAUSS_NEWTON: damped Gauss-Newton minimization with a preconditioned sparse solver
+//SOLVER_LBFGS: limited-memory BFGS minimization that keeps its curvature information between the iterations
+enum SolverType
+{
+	SOLVER_LBFGSB,
+	SOLVER_GAUSS_NEWTON,
+	SOLVER_LBFGS
+};
+
+const SolverType SOLVER_TYPE = SOLVER_LBFGSB;
+
+//Fraction of changed correspondences above which SOLVER_LBFGS discards the curvature information of the previous iterations
+const double LBFGS_RESET_FRACTION = 0.25;
+
+//Storage precision of the kd tree and the per-vertex data of the fitting energy, can be overridden on the command line
+//PRECISION_DOUBLE: double storage
+//PRECISION_FLOAT: float storage with double accumulation, the affine parameters and the minimization remain double
+enum Precision
+{
+	PRECISION_DOUBLE,
+	PRECISION_FLOAT
+};
+
+const Precision FIT_PRECISION = PRECISION_DOUBLE;
+
 //Enables per-iteration printouts of LBFGSB
 //#define OUTPUT_TRACE
 
+//Enables printouts of the run times of the individual fitting steps
+//#define OUTPUT_TIMING
+
 #endif
\ No newline at end of file
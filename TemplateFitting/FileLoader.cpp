@@ -12,12 +12,31 @@
 /*************************************************************************************************************************/
 
 #include "FileLoader.h"
+#include "BinaryMesh.h"
+#include "MappedFile.h"
 #include "MathHelper.h"
+#include "Definitions.h"
+#include "Timer.h"
 
+#include <algorithm>
+#include <charconv>
 #include <fstream>
+#include <limits>
+#include <sstream>
 #include <string>
 #include <iostream>
 
+FileLoader::FileLoader()
+: m_pLogStream(&std::cout)
+{
+
+}
+
+void FileLoader::setLogStream(std::ostream& logStream)
+{
+	m_pLogStream = &logStream;
+}
+
 std::string FileLoader::getFileExtension(const std::string& sstrFileName)
 {
 	if(sstrFileName.empty())
@@ -134,30 +153,43 @@ bool FileLoader::loadFile(const std::string& sstrFileName, DataContainer& outDat
 
 	bool bReturn(false);
 
+#ifdef OUTPUT_TIMING
+	Timer parseTimer;
+#endif
+
 	const std::string sstrSuffix = FileLoader::getFileExtension(sstrFileName);
 	if(sstrSuffix=="off")
 	{
 		bReturn = loadOFF(sstrFileName, outData);
-		if(bReturn)
-		{
-			MathHelper::cleanMesh(outData);
-		}
 	}
 	else if(sstrSuffix=="wrl")
 	{
 		bReturn = loadWRL(sstrFileName, outData);
-		if(bReturn)
-		{
-			MathHelper::cleanMesh(outData);
-		}
 	}
 	else if (sstrSuffix=="obj")
 	{
 		bReturn = loadObj(sstrFileName, outData);
-		if(bReturn)
-		{
-			MathHelper::cleanMesh(outData);
-		}
+	}
+	else if(sstrSuffix=="bmsh")
+	{
+		bReturn = loadBinaryMesh(sstrFileName, outData);
+	}
+	else if(sstrSuffix=="ply")
+	{
+		bReturn = loadPly(sstrFileName, outData);
+	}
+
+#ifdef OUTPUT_TIMING
+	const double parseTime = parseTimer.elapsedMilliseconds();
+	std::ifstream inStream(sstrFileName.c_str(), std::ios::binary | std::ios::ate);
+	const double fileSizeMB = inStream.is_open() ? static_cast<double>(inStream.tellg())/(1024.0*1024.0) : 0.0;
+	*m_pLogStream << "Parsing " << sstrFileName << " (" << fileSizeMB << " MB): " << parseTime << " ms (" << (parseTime > 0.0 ? 1000.0*fileSizeMB/parseTime : 0.0) << " MB/s)" << std::endl;
+#endif
+
+	//Binary meshes may be written by other tools and are cleaned like all other formats
+	if(bReturn)
+	{
+		MathHelper::cleanMesh(outData, *m_pLogStream);
 	}
 
 	return bReturn;
@@ -228,32 +260,213 @@ bool FileLoader::loadWRL(const std::string& sstrFileName, DataContainer& outData
 		}
 	}
 
-	return fclose(pFile)==0;
+	if(fclose(pFile)!=0)
+	{
+		return false;
+	}
+
+	//Texture polygons are fanned like the vertex polygons, which only matches if both have the same polygons
+	const size_t numTextureFaces = outData.getTextureIndexList().size();
+	if(numTextureFaces > 0 && numTextureFaces != outData.getNumFaces())
+	{
+		*m_pLogStream << "Texture indices do not match the faces of " << sstrFileName << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+namespace
+{
+	//Bulk tokenizer over a memory block with the token rules of FileLoader::readNextNode:
+	//Tokens are separated by white space, # starts a comment till the end of the line and the brackets [ { } \ are single character tokens
+	class TextScanner
+	{
+	public:
+		TextScanner(const char* begin, const char* end)
+		: m_pCurr(begin)
+		, m_pEnd(end)
+		{
+
+		}
+
+		//! Returns false at the end of the block
+		bool nextToken(const char*& tokenBegin, const char*& tokenEnd)
+		{
+			while(m_pCurr < m_pEnd)
+			{
+				const unsigned char currChar = static_cast<unsigned char>(*m_pCurr);
+				if(currChar <= 32)
+				{
+					++m_pCurr;
+				}
+				else if(currChar == '#')
+				{
+					skipLine();
+				}
+				else
+				{
+					break;
+				}
+			}
+
+			if(m_pCurr == m_pEnd)
+			{
+				return false;
+			}
+
+			tokenBegin = m_pCurr;
+			if(isBracket(*m_pCurr))
+			{
+				tokenEnd = ++m_pCurr;
+				return true;
+			}
+
+			while(m_pCurr < m_pEnd && static_cast<unsigned char>(*m_pCurr) > 32 && *m_pCurr != '#' && !isBracket(*m_pCurr))
+			{
+				++m_pCurr;
+			}
+
+			tokenEnd = m_pCurr;
+			return true;
+		}
+
+		template<typename Unit>
+		bool nextNumber(Unit& number)
+		{
+			const char* tokenBegin(NULL);
+			const char* tokenEnd(NULL);
+			return nextToken(tokenBegin, tokenEnd) && parseNumber(tokenBegin, tokenEnd, number);
+		}
+
+		//! Moves to the start of the next line
+		void skipLine()
+		{
+			const char* pLineEnd = static_cast<const char*>(memchr(m_pCurr, '\n', m_pEnd-m_pCurr));
+			m_pCurr = pLineEnd != NULL ? pLineEnd+1 : m_pEnd;
+		}
+
+		const char* getPosition() const { return m_pCurr; }
+
+		//! Parses the number at the start of the token like sscanf, a leading + is allowed
+		template<typename Unit>
+		static bool parseNumber(const char* tokenBegin, const char* tokenEnd, Unit& number)
+		{
+			if(tokenBegin < tokenEnd && *tokenBegin == '+')
+			{
+				++tokenBegin;
+			}
+
+			const std::from_chars_result result = std::from_chars(tokenBegin, tokenEnd, number);
+			return result.ec == std::errc() && result.ptr != tokenBegin;
+		}
+
+	private:
+		static bool isBracket(const char c)
+		{
+			return c == '[' || c == '\\' || c == '{' || c == '}';
+		}
+
+		const char* m_pCurr;
+		const char* m_pEnd;
+	};
+
+	//End of the line starting at lineBegin, excluding the line break
+	const char* getLineEnd(const char* lineBegin, const char* end)
+	{
+		const char* pLineEnd = static_cast<const char*>(memchr(lineBegin, '\n', end-lineBegin));
+		return pLineEnd != NULL ? pLineEnd : end;
+	}
+
+	//Start of all lines of the block that contain a token, lines with only white space or a comment are skipped
+	void computeDataLines(const char* begin, const char* end, std::vector<const char*>& lineStarts)
+	{
+		lineStarts.clear();
+
+		const char* pCurr = begin;
+		while(pCurr < end)
+		{
+			const char* pLineEnd = getLineEnd(pCurr, end);
+
+			const char* pFirst = pCurr;
+			while(pFirst < pLineEnd && static_cast<unsigned char>(*pFirst) <= 32)
+			{
+				++pFirst;
+			}
+
+			if(pFirst < pLineEnd && *pFirst != '#')
+			{
+				lineStarts.push_back(pCurr);
+			}
+
+			pCurr = pLineEnd+1;
+		}
+	}
+
+	//Parses exactly num numbers from the line
+	template<typename Unit>
+	bool parseLine(const char* lineBegin, const char* end, const size_t num, Unit* numbers)
+	{
+		TextScanner scanner(lineBegin, getLineEnd(lineBegin, end));
+
+		for(size_t i = 0; i < num; ++i)
+		{
+			if(!scanner.nextNumber(numbers[i]))
+			{
+				return false;
+			}
+		}
+
+		const char* tokenBegin(NULL);
+		const char* tokenEnd(NULL);
+		return !scanner.nextToken(tokenBegin, tokenEnd);
+	}
+
+	//Checks in parallel that all vertex indices of the triangles refer to one of the numVertices vertices
+	bool hasValidIndices(const std::vector<int>& triangleList, const size_t numVertices)
+	{
+		int numInvalidIndices(0);
+
+#pragma omp parallel for reduction(+:numInvalidIndices)
+		for(int i = 0; i < static_cast<int>(triangleList.size()); ++i)
+		{
+			if(triangleList[i] < 0 || static_cast<size_t>(triangleList[i]) >= numVertices)
+			{
+				++numInvalidIndices;
+			}
+		}
+
+		return numInvalidIndices == 0;
+	}
 }
 
 bool FileLoader::loadOFF(const std::string& sstrFileName, DataContainer& outData)
 {
-	const char* cstrFileName = sstrFileName.c_str();
-	if(cstrFileName==NULL)
+	//The whole file is mapped and tokenized in memory
+	MappedFile file;
+	if(!file.open(sstrFileName))
 	{
 		return false;
 	}
 
-	FILE* pFile = fopen(cstrFileName, "r");
-	if(pFile==NULL)
+	const char* fileEnd = file.getData()+file.getSize();
+	TextScanner scanner(file.getData(), fileEnd);
+
+	const char* tokenBegin(NULL);
+	const char* tokenEnd(NULL);
+	if(!scanner.nextToken(tokenBegin, tokenEnd))
 	{
 		return false;
 	}
 
-	char output[1000] = "";
-	readNextNode(pFile, output);
+	const std::string sstrHeader(tokenBegin, tokenEnd);
 
 	bool bColorOff(false);
-	if(strcmp(output, "OFF") == 0)
+	if(sstrHeader == "OFF")
 	{
 		bColorOff = false;
 	}
-	else if(strcmp(output, "COFF") == 0)
+	else if(sstrHeader == "COFF")
 	{
 		bColorOff = true;
 	}
@@ -263,321 +476,1036 @@ bool FileLoader::loadOFF(const std::string& sstrFileName, DataContainer& outData
 	}
 
 	int numVertices(0);
-	readNextNumber(pFile, INTEGER, output, numVertices);
+	scanner.nextNumber(numVertices);
 
 	int numFaces(0);
-	readNextNumber(pFile, INTEGER, output, numFaces);
+	scanner.nextNumber(numFaces);
 
 	int numEdges(0);
-	readNextNumber(pFile, INTEGER, output, numEdges);
+	scanner.nextNumber(numEdges);
 
 	if(numVertices < 1 /*|| numFaces < 1*/)
 	{
 		return false;
 	}
 
-	std::vector<double> vertexList;
-	std::vector<std::vector<int>> vertexIndexList;
-	std::vector<double> vertexColorList;
+	numFaces = std::max(numFaces, 0);
 
-	bool bEnd(false);
-	for(int vertex = 0; vertex < numVertices; ++vertex)
+	std::vector<double> vertexList(3*numVertices);
+	std::vector<int> triangleList(3*numFaces);
+	std::vector<double> vertexColorList(bColorOff ? 3*numVertices : 0);
+
+	//With one vertex or face per line, the lines are parsed in parallel straight into the vertex and face lists.
+	//Files with other line layouts or less lines than vertices and faces are tokenized sequentially.
+	std::vector<const char*> lineStarts;
+	computeDataLines(scanner.getPosition(), fileEnd, lineStarts);
+
+	bool bParsed(false);
+	if(lineStarts.size() >= static_cast<size_t>(numVertices)+static_cast<size_t>(numFaces))
 	{
-		char tmpOutput[1000];
-	
-		for(int i = 0; i < 3; ++i)
+		const size_t numVertexValues = bColorOff ? 7 : 3;
+		int numInvalidLines(0);
+		int numNonTriangles(0);
+
+#pragma omp parallel for reduction(+:numInvalidLines)
+		for(int vertex = 0; vertex < numVertices; ++vertex)
 		{
-			double number(0.0);		
-			if(!readNextNumber(pFile, FLOATING_POINT, tmpOutput, number))
+			double values[7];
+			if(!parseLine(lineStarts[vertex], fileEnd, numVertexValues, values))
 			{
-				bEnd = true;
-				break;
+				++numInvalidLines;
+				continue;
+			}
+
+			for(size_t i = 0; i < 3; ++i)
+			{
+				vertexList[3*vertex+i] = values[i];
 			}
 
-			vertexList.push_back(number);
+			if(bColorOff)
+			{
+				for(size_t i = 0; i < 3; ++i)
+				{
+					vertexColorList[3*vertex+i] = values[3+i];
+				}
+			}
 		}
 
-		if(bEnd || vertexList.size()%3 != 0)
+#pragma omp parallel for reduction(+:numInvalidLines, numNonTriangles)
+		for(int face = 0; face < numFaces; ++face)
 		{
-			std::cout << "Loaded vertex list of wrong dimension" << std::endl;
+			const char* lineBegin = lineStarts[numVertices+face];
+			TextScanner lineScanner(lineBegin, getLineEnd(lineBegin, fileEnd));
+
+			int numPolyPoints(0);
+			if(!lineScanner.nextNumber(numPolyPoints))
+			{
+				++numInvalidLines;
+				continue;
+			}
+
+			if(numPolyPoints != 3)
+			{
+				++numNonTriangles;
+				continue;
+			}
+
+			const char* tokenBegin(NULL);
+			const char* tokenEnd(NULL);
+			int* polyIndices = &triangleList[3*face];
+			if(!lineScanner.nextNumber(polyIndices[0]) || !lineScanner.nextNumber(polyIndices[1]) || !lineScanner.nextNumber(polyIndices[2]) || lineScanner.nextToken(tokenBegin, tokenEnd))
+			{
+				++numInvalidLines;
+			}
+		}
+
+		if(numNonTriangles > 0 && numInvalidLines == 0)
+		{
+#ifdef DEBUG_OUTPUT
+			*m_pLogStream << "loadOff() - only triangles supported" << std::endl; 
+#endif
 			return false;
 		}
 
-		if(bColorOff)
+		bParsed = numInvalidLines == 0;
+	}
+
+	if(!bParsed)
+	{
+		for(int vertex = 0; vertex < numVertices; ++vertex)
 		{
 			for(int i = 0; i < 3; ++i)
 			{
-				double colorValue(0);		
-				if(!readNextNumber(pFile, FLOATING_POINT, tmpOutput, colorValue))
+				if(!scanner.nextNumber(vertexList[3*vertex+i]))
 				{
-					bEnd = true;
-					break;
+					*m_pLogStream << "Loaded vertex list of wrong dimension" << std::endl;
+					return false;
 				}
+			}
 
-				vertexColorList.push_back(colorValue);
+			if(bColorOff)
+			{
+				for(int i = 0; i < 3; ++i)
+				{
+					if(!scanner.nextNumber(vertexColorList[3*vertex+i]))
+					{
+						*m_pLogStream << "Loaded vertex color list of wrong dimension" << std::endl;
+						return false;
+					}
+				}
+
+				double alphaValue(0);		
+				if(!scanner.nextNumber(alphaValue))
+				{
+					return false;
+				}
 			}
+		}
 
-			if(bEnd || vertexColorList.size()%3 != 0)
+		for(int face = 0; face < numFaces; ++face)
+		{
+			int numPolyPoints(0);		
+			if(!scanner.nextNumber(numPolyPoints))
 			{
-				std::cout << "Loaded vertex color list of wrong dimension" << std::endl;
-				return false;
+				triangleList.resize(3*face);
+				break;
 			}
 
-			double alphaValue(0);		
-			if(!readNextNumber(pFile, FLOATING_POINT, tmpOutput, alphaValue))
+			if(numPolyPoints!=3)
 			{
+#ifdef DEBUG_OUTPUT
+				*m_pLogStream << "loadOff() - only triangles supported" << std::endl; 
+#endif
 				return false;
 			}
+
+			int* polyIndices = &triangleList[3*face];
+			if(!scanner.nextNumber(polyIndices[0]) || !scanner.nextNumber(polyIndices[1]) || !scanner.nextNumber(polyIndices[2]))
+			{
+				*m_pLogStream << "Polygon not considered" << std::endl;
+				triangleList.resize(3*face);
+				break;
+			}
 		}
 	}
 
-	for(int face = 0; face < numFaces; ++face)
+	if(!hasValidIndices(triangleList, vertexList.size()/3))
 	{
-		char tmpOutput[1000];
+		*m_pLogStream << "Invalid vertex index in " << sstrFileName << std::endl;
+		return false;
+	}
 
-		int numPolyPoints(0);		
-		if(!readNextNumber(pFile, INTEGER, tmpOutput, numPolyPoints))
-		{
-			break;
-		}
+	if(!outData.setVertexList(std::move(vertexList)))
+	{
+		return false;
+	}
 
-		if(numPolyPoints!=3)
-		{
-#ifdef DEBUG_OUTPUT
-			std::cout << "loadOff() - only triangles supported" << std::endl; 
-#endif
-			return false;
-		}
+	outData.setTriangleList(std::move(triangleList));
+	outData.setVertexColorList(std::move(vertexColorList)); 
+
+	return true;
+}
+
+namespace
+{
+	//Approximate size of the line-aligned blocks of an OBJ file that are parsed in parallel
+	const size_t OBJ_CHUNK_SIZE = 1 << 22;
+
+	//Vertices and triangles of one block of an OBJ file
+	struct ObjChunk
+	{
+		std::vector<double> vertices;
+
+		//Vertex indices of the triangles, 3 per triangle
+		std::vector<int> triangles;
+
+		//Positions within triangles of indices given relative to the last vertex, they are stored relative to the first vertex of the block
+		std::vector<size_t> blockRelativeIndices;
+	};
+
+	//Parses the v and f lines of the block, returns false for invalid vertex or face lines
+	bool parseObjChunk(const char* begin, const char* end, ObjChunk& chunk)
+	{
+		std::vector<int> polygon;
+		std::vector<char> relativePolygon;
 
-		std::vector<int> polyIndices;
-		for(int i = 0; i < 3; ++i)
+		const char* pLineBegin = begin;
+		while(pLineBegin < end)
 		{
-			int vertexIndex(0);		
-			if(!readNextNumber(pFile, INTEGER, tmpOutput, vertexIndex))
+			const char* pLineEnd = getLineEnd(pLineBegin, end);
+			TextScanner scanner(pLineBegin, pLineEnd);
+			pLineBegin = pLineEnd+1;
+
+			const char* tokenBegin(NULL);
+			const char* tokenEnd(NULL);
+			if(!scanner.nextToken(tokenBegin, tokenEnd) || tokenEnd-tokenBegin != 1)
 			{
-				bEnd = true;
-				break;
+				//Normals, texture coordinates and all other elements are skipped
+				continue;
 			}
 
-			polyIndices.push_back(vertexIndex);
+			if(*tokenBegin == 'v')
+			{
+				for(int i = 0; i < 3; ++i)
+				{
+					double number(0.0);
+					if(!scanner.nextNumber(number))
+					{
+						return false;
+					}
+
+					chunk.vertices.push_back(number);
+				}
+			}
+			else if(*tokenBegin == 'f')
+			{
+				//Vertex indices are 1-based, negative indices are relative to the last vertex, texture and normal indices after / are skipped
+				const int numCurrVertices = static_cast<int>(chunk.vertices.size()/3);
+
+				polygon.clear();
+				relativePolygon.clear();
+				while(scanner.nextToken(tokenBegin, tokenEnd))
+				{
+					const char* pSlash = static_cast<const char*>(memchr(tokenBegin, '/', tokenEnd-tokenBegin));
+
+					int vertexNum(0);
+					if(!TextScanner::parseNumber(tokenBegin, pSlash != NULL ? pSlash : tokenEnd, vertexNum) || vertexNum == 0)
+					{
+						return false;
+					}
+
+					polygon.push_back(vertexNum > 0 ? vertexNum-1 : numCurrVertices+vertexNum);
+					relativePolygon.push_back(vertexNum < 0);
+				}
+
+				if(polygon.size() < 3)
+				{
+					return false;
+				}
+
+				//Polygons are split into a triangle fan
+				for(size_t i = 2; i < polygon.size(); ++i)
+				{
+					const size_t fanIndices[3] = {0, i-1, i};
+					for(size_t j = 0; j < 3; ++j)
+					{
+						if(relativePolygon[fanIndices[j]])
+						{
+							chunk.blockRelativeIndices.push_back(chunk.triangles.size());
+						}
+
+						chunk.triangles.push_back(polygon[fanIndices[j]]);
+					}
+				}
+			}
 		}
 
-		if(bEnd || polyIndices.size() % 3 != 0) 
+		return true;
+	}
+}
+
+bool FileLoader::loadObj(const std::string& sstrFileName, DataContainer& outData)
+{
+	//The whole file is mapped and split into line-aligned blocks, which are parsed in parallel
+	MappedFile file;
+	if(!file.open(sstrFileName))
+	{
+		return false;
+	}
+
+	const char* fileBegin = file.getData();
+	const char* fileEnd = fileBegin+file.getSize();
+
+	std::vector<const char*> chunkStarts(1, fileBegin);
+	while(static_cast<size_t>(fileEnd-chunkStarts.back()) > OBJ_CHUNK_SIZE)
+	{
+		const char* pLineEnd = getLineEnd(chunkStarts.back()+OBJ_CHUNK_SIZE, fileEnd);
+		if(pLineEnd == fileEnd)
 		{
-			std::cout << "Polygon not considered" << std::endl;
 			break;
 		}
 
-		vertexIndexList.push_back(polyIndices);
+		chunkStarts.push_back(pLineEnd+1);
 	}
+	chunkStarts.push_back(fileEnd);
+
+	const int numChunks = static_cast<int>(chunkStarts.size()-1);
+	std::vector<ObjChunk> chunks(numChunks);
 
+	int numInvalidChunks(0);
 
-	if(!outData.setVertexList(vertexList))
+#pragma omp parallel for schedule(dynamic) reduction(+:numInvalidChunks)
+	for(int i = 0; i < numChunks; ++i)
+	{
+		if(!parseObjChunk(chunkStarts[i], chunkStarts[i+1], chunks[i]))
+		{
+			++numInvalidChunks;
+		}
+	}
+
+	if(numInvalidChunks > 0)
 	{
 		return false;
 	}
 
-	outData.setVertexIndexList(vertexIndexList);
-	outData.setVertexColorList(vertexColorList); 
+	//First vertex and triangle of each block within the concatenated lists
+	std::vector<size_t> vertexOffsets(numChunks+1, 0);
+	std::vector<size_t> triangleOffsets(numChunks+1, 0);
+	for(int i = 0; i < numChunks; ++i)
+	{
+		vertexOffsets[i+1] = vertexOffsets[i] + chunks[i].vertices.size()/3;
+		triangleOffsets[i+1] = triangleOffsets[i] + chunks[i].triangles.size()/3;
+	}
 
-	return fclose(pFile)==0;
+	std::vector<double> vertexList(3*vertexOffsets[numChunks]);
+	std::vector<int> triangleList(3*triangleOffsets[numChunks]);
+	std::vector<double> vertexColors;
+
+#pragma omp parallel for schedule(dynamic)
+	for(int i = 0; i < numChunks; ++i)
+	{
+		ObjChunk& chunk = chunks[i];
+		std::copy(chunk.vertices.begin(), chunk.vertices.end(), vertexList.begin()+3*vertexOffsets[i]);
+
+		const int vertexOffset = static_cast<int>(vertexOffsets[i]);
+		for(size_t j = 0; j < chunk.blockRelativeIndices.size(); ++j)
+		{
+			chunk.triangles[chunk.blockRelativeIndices[j]] += vertexOffset;
+		}
+
+		std::copy(chunk.triangles.begin(), chunk.triangles.end(), triangleList.begin()+3*triangleOffsets[i]);
+	}
+
+	//Indices of missing vertices and relative indices before the first vertex fail the load
+	if(!hasValidIndices(triangleList, vertexOffsets[numChunks]))
+	{
+		*m_pLogStream << "Invalid vertex index in " << sstrFileName << std::endl;
+		return false;
+	}
+
+	outData.setVertexList(std::move(vertexList));
+	outData.setTriangleList(std::move(triangleList));
+	outData.setVertexColorList(std::move(vertexColors));
+
+	return true;
 }
 
-bool FileLoader::loadObj(const std::string& sstrFileName, DataContainer& outData)
+namespace
 {
-	const char* cstrFileName = sstrFileName.c_str();
-	if(cstrFileName==NULL)
+	//Converts a block of 3*num values of the mapped file to double
+	template<typename Scalar>
+	void copyBinaryBlock(const char* data, const uint64_t num, std::vector<double>& values)
 	{
-		return false;
+		const Scalar* block = reinterpret_cast<const Scalar*>(data);
+		values.assign(block, block+3*num);
 	}
+}
 
-	FILE* pFile = fopen(cstrFileName, "r");
-	if(pFile==NULL)
+bool FileLoader::loadBinaryMesh(const std::string& sstrFileName, DataContainer& outData)
+{
+	MappedFile file;
+	if(!file.open(sstrFileName) || file.getSize() < sizeof(BinaryMeshHeader))
 	{
 		return false;
 	}
 
-	std::vector<double> vertexList;
-	std::vector<std::vector<int>> vertexIndexList;
-	std::vector<double> vertexColors;
+	const char* data = file.getData();
+	const uint64_t fileSize = file.getSize();
 
-	bool bEnd(false);
+	BinaryMeshHeader header;
+	memcpy(&header, data, sizeof(BinaryMeshHeader));
+	if(memcmp(header.magic, BINARY_MESH_MAGIC, sizeof(header.magic)) != 0 || header.version != BINARY_MESH_VERSION)
+	{
+		*m_pLogStream << "Unsupported binary mesh " << sstrFileName << std::endl;
+		return false;
+	}
 
-	char output[1000];
-	while(strcmp(output, "v") != 0 
-			&& strcmp(output, "vn") != 0 
-			&& strcmp(output, "vt") != 0
-			&& strcmp(output, "f") != 0 
-			&& !bEnd)
+	const bool bFloat32 = (header.flags & BINARY_MESH_FLOAT32) != 0;
+	const bool bColors = (header.flags & BINARY_MESH_COLORS) != 0;
+	const uint64_t scalarSize = bFloat32 ? sizeof(float) : sizeof(double);
+
+	//All blocks must be aligned and lie within the file
+	const uint64_t numVertices = header.numVertices;
+	const uint64_t numTriangles = header.numTriangles;
+	if(numVertices > fileSize || numTriangles > fileSize
+		|| header.vertexOffset%8 != 0 || header.vertexOffset > fileSize || 3*numVertices*scalarSize > fileSize-header.vertexOffset
+		|| header.triangleOffset%8 != 0 || header.triangleOffset > fileSize || 3*numTriangles*sizeof(uint32_t) > fileSize-header.triangleOffset
+		|| (bColors && (header.colorOffset%8 != 0 || header.colorOffset > fileSize || 3*numVertices*scalarSize > fileSize-header.colorOffset)))
 	{
-		bEnd = readNextNode(pFile, output);
+		*m_pLogStream << "Corrupt binary mesh " << sstrFileName << std::endl;
+		return false;
 	}
 
-	//Read vertices
-	while(strcmp(output, "v") == 0 && !bEnd)
+	std::vector<double> vertices;
+	std::vector<double> vertexColors;
+	if(bFloat32)
 	{
-		char tmpOutput[1000];
-	
-		Vec3d* pVertex = new Vec3d(0.0,0.0,0.0);
-		for(int i = 0; i < 3; ++i)
+		copyBinaryBlock<float>(data+header.vertexOffset, numVertices, vertices);
+		if(bColors)
 		{
-			double number(0.0);		
-			if(!readNextNumber(pFile, FLOATING_POINT, tmpOutput, number))
-			{
-				bEnd = true;
-				break;
-			}
-
-			vertexList.push_back(number);
+			copyBinaryBlock<float>(data+header.colorOffset, numVertices, vertexColors);
+		}
+	}
+	else
+	{
+		copyBinaryBlock<double>(data+header.vertexOffset, numVertices, vertices);
+		if(bColors)
+		{
+			copyBinaryBlock<double>(data+header.colorOffset, numVertices, vertexColors);
 		}
+	}
 
-		if(bEnd || vertexList.size()%3 != 0)
+	const uint32_t* triangles = reinterpret_cast<const uint32_t*>(data+header.triangleOffset);
+
+	//The triangle block is copied as a whole and validated afterwards
+	std::vector<int> triangleList(triangles, triangles+3*numTriangles);
+	for(size_t i = 0; i < triangleList.size(); ++i)
+	{
+		if(static_cast<uint32_t>(triangleList[i]) >= numVertices)
 		{
+			*m_pLogStream << "Corrupt binary mesh " << sstrFileName << std::endl;
 			return false;
 		}
-
-		bEnd = readNextNode(pFile, output);
 	}
 
-	while(strcmp(output, "v") != 0 
-			&& strcmp(output, "vn") != 0 
-			&& strcmp(output, "vt") != 0
-			&& strcmp(output, "f") != 0 
-			&& !bEnd)
+	outData.clear();
+	outData.setVertexList(std::move(vertices));
+	outData.setTriangleList(std::move(triangleList));
+	outData.setVertexColorList(std::move(vertexColors));
+	return true;
+}
+
+namespace
+{
+	enum PlyFormat
 	{
-		bEnd = readNextNode(pFile, output);
-	}
+		PLY_ASCII,
+		PLY_BINARY_LITTLE_ENDIAN,
+		PLY_BINARY_BIG_ENDIAN
+	};
 
-	//Read normals
-	while(strcmp(output, "vn") == 0 && !bEnd)
+	enum PlyType
 	{
-		char tmpOutput[1000];
+		PLY_INVALID,
+		PLY_INT8,
+		PLY_UINT8,
+		PLY_INT16,
+		PLY_UINT16,
+		PLY_INT32,
+		PLY_UINT32,
+		PLY_FLOAT32,
+		PLY_FLOAT64
+	};
+
+	//Meaning of a property for the loaded mesh, properties without role (e.g. normals) are skipped
+	enum PlyRole
+	{
+		PLY_SKIP = -1,
+		PLY_X,
+		PLY_Y,
+		PLY_Z,
+		PLY_RED,
+		PLY_GREEN,
+		PLY_BLUE,
+		PLY_VERTEX_INDICES
+	};
+
+	struct PlyProperty
+	{
+		std::string sstrName;
+		PlyType type;
+
+		//Type of the number of values of a list property, PLY_INVALID for scalar properties
+		PlyType countType;
+	};
+
+	struct PlyElement
+	{
+		std::string sstrName;
+		uint64_t count;
+		std::vector<PlyProperty> properties;
+	};
+
+	PlyType getPlyType(const std::string& sstrType)
+	{
+		if(sstrType == "char" || sstrType == "int8")			return PLY_INT8;
+		if(sstrType == "uchar" || sstrType == "uint8")			return PLY_UINT8;
+		if(sstrType == "short" || sstrType == "int16")			return PLY_INT16;
+		if(sstrType == "ushort" || sstrType == "uint16")		return PLY_UINT16;
+		if(sstrType == "int" || sstrType == "int32")			return PLY_INT32;
+		if(sstrType == "uint" || sstrType == "uint32")			return PLY_UINT32;
+		if(sstrType == "float" || sstrType == "float32")		return PLY_FLOAT32;
+		if(sstrType == "double" || sstrType == "float64")		return PLY_FLOAT64;
+		return PLY_INVALID;
+	}
 
-		for(int i = 0; i < 3; ++i)
+	size_t getPlyTypeSize(const PlyType type)
+	{
+		switch(type)
 		{
-			double number(0.0);		
-			if(!readNextNumber(pFile, FLOATING_POINT, tmpOutput, number))
-			{
-				bEnd = true;
-				break;
-			}
+		case PLY_INT8:
+		case PLY_UINT8:
+			return 1;
+		case PLY_INT16:
+		case PLY_UINT16:
+			return 2;
+		case PLY_INT32:
+		case PLY_UINT32:
+		case PLY_FLOAT32:
+			return 4;
+		case PLY_FLOAT64:
+			return 8;
+		default:
+			return 0;
 		}
+	}
 
-		if(bEnd)
+	//Factor that maps integer colors to [0,1], float colors are taken as they are
+	double getPlyColorScale(const PlyType type)
+	{
+		switch(type)
 		{
-			return false;
+		case PLY_UINT8:
+			return 1.0/255.0;
+		case PLY_UINT16:
+			return 1.0/65535.0;
+		default:
+			return 1.0;
 		}
-
-		bEnd = readNextNode(pFile, output);
 	}
 
-	while(strcmp(output, "v") != 0 
-			&& strcmp(output, "vn") != 0 
-			&& strcmp(output, "vt") != 0
-			&& strcmp(output, "f") != 0 
-			&& !bEnd)
+	PlyRole getPlyRole(const PlyElement& element, const PlyProperty& property)
 	{
-		bEnd = readNextNode(pFile, output);
+		const bool bList = property.countType != PLY_INVALID;
+		if(element.sstrName == "vertex" && !bList)
+		{
+			if(property.sstrName == "x")		return PLY_X;
+			if(property.sstrName == "y")		return PLY_Y;
+			if(property.sstrName == "z")		return PLY_Z;
+			if(property.sstrName == "red")		return PLY_RED;
+			if(property.sstrName == "green")	return PLY_GREEN;
+			if(property.sstrName == "blue")		return PLY_BLUE;
+		}
+		else if(element.sstrName == "face" && bList)
+		{
+			if(property.sstrName == "vertex_indices" || property.sstrName == "vertex_index")	return PLY_VERTEX_INDICES;
+		}
+
+		return PLY_SKIP;
 	}
 
-	//Read texture coordinates
-	while(strcmp(output, "vt") == 0 && !bEnd)
+	//Parses the header lines up to end_header, dataOffset is the position of the first byte after the header
+	bool readPlyHeader(const char* data, const char* end, PlyFormat& format, std::vector<PlyElement>& elements, size_t& dataOffset)
 	{
-		char tmpOutput[1000];
+		if(end-data < 3 || memcmp(data, "ply", 3) != 0)
+		{
+			return false;
+		}
 
-		for(int i = 0; i < 2; ++i)
+		bool bFormat(false);
+
+		const char* pCurr = data;
+		while(pCurr < end)
 		{
-			double number(0.0);		
-			if(!readNextNumber(pFile, FLOATING_POINT, tmpOutput, number))
+			const char* lineEnd = getLineEnd(pCurr, end);
+			std::istringstream line(std::string(pCurr, lineEnd));
+			pCurr = lineEnd < end ? lineEnd+1 : end;
+
+			std::string sstrKeyword;
+			line >> sstrKeyword;
+			if(sstrKeyword == "format")
 			{
-				bEnd = true;
-				break;
+				std::string sstrFormat;
+				line >> sstrFormat;
+				if(sstrFormat == "ascii")						format = PLY_ASCII;
+				else if(sstrFormat == "binary_little_endian")	format = PLY_BINARY_LITTLE_ENDIAN;
+				else if(sstrFormat == "binary_big_endian")		format = PLY_BINARY_BIG_ENDIAN;
+				else											return false;
+
+				bFormat = true;
 			}
+			else if(sstrKeyword == "element")
+			{
+				PlyElement element;
+				line >> element.sstrName >> element.count;
+				if(line.fail())
+				{
+					return false;
+				}
+
+				elements.push_back(element);
+			}
+			else if(sstrKeyword == "property")
+			{
+				if(elements.empty())
+				{
+					return false;
+				}
+
+				std::string sstrType;
+				line >> sstrType;
+
+				PlyProperty property;
+				property.countType = PLY_INVALID;
+				if(sstrType == "list")
+				{
+					std::string sstrCountType;
+					line >> sstrCountType >> sstrType;
+
+					//Numbers of list values must be integers
+					property.countType = getPlyType(sstrCountType);
+					if(property.countType == PLY_INVALID || property.countType == PLY_FLOAT32 || property.countType == PLY_FLOAT64)
+					{
+						return false;
+					}
+				}
+
+				property.type = getPlyType(sstrType);
+				line >> property.sstrName;
+				if(property.type == PLY_INVALID || line.fail())
+				{
+					return false;
+				}
+
+				elements.back().properties.push_back(property);
+			}
+			else if(sstrKeyword == "end_header")
+			{
+				dataOffset = pCurr-data;
+				return bFormat;
+			}
+
+			//ply, comment and obj_info lines are skipped
 		}
 
-		if(bEnd)
+		return false;
+	}
+
+	template<typename Value>
+	double convertPlyValue(const char* bytes)
+	{
+		Value value;
+		memcpy(&value, bytes, sizeof(Value));
+		return static_cast<double>(value);
+	}
+
+	//Reads one binary value of the given type, values of big-endian files are byte swapped
+	double readPlyValue(const char* data, const PlyType type, const bool bSwap)
+	{
+		char bytes[8];
+		const size_t size = getPlyTypeSize(type);
+		if(bSwap)
 		{
-			return false;
+			std::reverse_copy(data, data+size, bytes);
+		}
+		else
+		{
+			memcpy(bytes, data, size);
 		}
 
-		bEnd = readNextNode(pFile, output);
+		switch(type)
+		{
+		case PLY_INT8:		return convertPlyValue<int8_t>(bytes);
+		case PLY_UINT8:		return convertPlyValue<uint8_t>(bytes);
+		case PLY_INT16:		return convertPlyValue<int16_t>(bytes);
+		case PLY_UINT16:	return convertPlyValue<uint16_t>(bytes);
+		case PLY_INT32:		return convertPlyValue<int32_t>(bytes);
+		case PLY_UINT32:	return convertPlyValue<uint32_t>(bytes);
+		case PLY_FLOAT32:	return convertPlyValue<float>(bytes);
+		case PLY_FLOAT64:	return convertPlyValue<double>(bytes);
+		default:			return 0.0;
+		}
 	}
 
-	while(strcmp(output, "v") != 0 
-			&& strcmp(output, "vn") != 0 
-			&& strcmp(output, "vt") != 0
-			&& strcmp(output, "f") != 0 
-			&& !bEnd)
+	//Stores the value of a vertex property with the given role
+	void setPlyVertexValue(const PlyRole role, const PlyType type, const double value, const size_t vertex, std::vector<double>& vertexList, std::vector<double>& vertexColorList)
 	{
-		bEnd = readNextNode(pFile, output);
+		if(role >= PLY_X && role <= PLY_Z)
+		{
+			vertexList[3*vertex+role] = value;
+		}
+		else if(role >= PLY_RED && role <= PLY_BLUE && !vertexColorList.empty())
+		{
+			vertexColorList[3*vertex+role-PLY_RED] = value*getPlyColorScale(type);
+		}
 	}
 
-	//Read faces
-	while(strcmp(output, "f") == 0 && !bEnd)
+	//Reads the rows of a binary element sequentially, vertex coordinates and colors are stored for the vertex element and triangles for the face element.
+	//Returns false if the data ends early or a face is no triangle.
+	bool readBinaryPlyRows(const char*& pCurr, const char* end, const PlyElement& element, const std::vector<PlyRole>& roles, const bool bSwap
+									, std::vector<double>& vertexList, std::vector<double>& vertexColorList, std::vector<int>& triangleList)
 	{
-		char tmpOutput[1000];
+		for(uint64_t row = 0; row < element.count; ++row)
+		{
+			for(size_t j = 0; j < element.properties.size(); ++j)
+			{
+				const PlyProperty& property = element.properties[j];
+				const size_t valueSize = getPlyTypeSize(property.type);
 
-		//Vec3i* pPoly = new Vec3i(0,0,0);
-		std::vector<int> polygon;
-		for(size_t i = 0; i < 3; ++i)
+				uint64_t numValues(1);
+				if(property.countType != PLY_INVALID)
+				{
+					const size_t countSize = getPlyTypeSize(property.countType);
+					if(static_cast<size_t>(end-pCurr) < countSize)
+					{
+						return false;
+					}
+
+					const double count = readPlyValue(pCurr, property.countType, bSwap);
+					if(count < 0.0)
+					{
+						return false;
+					}
+
+					numValues = static_cast<uint64_t>(count);
+					pCurr += countSize;
+				}
+
+				if(static_cast<uint64_t>(end-pCurr)/valueSize < numValues)
+				{
+					return false;
+				}
+
+				if(roles[j] == PLY_VERTEX_INDICES)
+				{
+					if(numValues != 3)
+					{
+#ifdef DEBUG_OUTPUT
+						std::cout << "loadPly() - only triangles supported" << std::endl; 
+#endif
+						return false;
+					}
+
+					int* polyIndices = &triangleList[3*row];
+					for(size_t k = 0; k < 3; ++k)
+					{
+						polyIndices[k] = static_cast<int>(readPlyValue(pCurr+k*valueSize, property.type, bSwap));
+					}
+				}
+				else if(roles[j] != PLY_SKIP)
+				{
+					setPlyVertexValue(roles[j], property.type, readPlyValue(pCurr, property.type, bSwap), row, vertexList, vertexColorList);
+				}
+
+				pCurr += numValues*valueSize;
+			}
+		}
+
+		return true;
+	}
+
+	//Reads a binary element with fixed size rows, i.e. without list properties or with triangles as the only list, in parallel.
+	//Returns false if the rows do not have this layout, the element is then read by readBinaryPlyRows.
+	bool readBinaryPlyFixedRows(const char*& pCurr, const char* end, const PlyElement& element, const std::vector<PlyRole>& roles, const bool bSwap
+										, std::vector<double>& vertexList, std::vector<double>& vertexColorList, std::vector<int>& triangleList)
+	{
+		//Offsets of the properties within a row, the index list is assumed to hold 3 indices
+		std::vector<size_t> offsets(element.properties.size());
+		size_t rowSize(0);
+		for(size_t j = 0; j < element.properties.size(); ++j)
 		{
-			bEnd = readNextNode(pFile, tmpOutput);
-			if(bEnd)
+			const PlyProperty& property = element.properties[j];
+			if(property.countType != PLY_INVALID && roles[j] != PLY_VERTEX_INDICES)
 			{
-				//delete pPoly;
 				return false;
 			}
 
-			const std::string sstrTmpOutput(tmpOutput);
+			offsets[j] = rowSize;
+			rowSize += property.countType != PLY_INVALID ? getPlyTypeSize(property.countType)+3*getPlyTypeSize(property.type) : getPlyTypeSize(property.type);
+		}
 
-			std::string sstrVertexNum("");
-			std::string sstrTexturNum("");
-			std::string sstrNormalNum("");
+		if(rowSize == 0 || static_cast<uint64_t>(end-pCurr)/rowSize < element.count)
+		{
+			return false;
+		}
 
-			const size_t pos1 = sstrTmpOutput.find_first_of("/");
-			if(pos1 != std::string::npos)
+		//Little-endian vertices with only x, y and z of the same floating point type are copied as one block
+		const std::vector<PlyProperty>& properties = element.properties;
+		if(!bSwap && properties.size() == 3 && roles[0] == PLY_X && roles[1] == PLY_Y && roles[2] == PLY_Z
+			&& properties[0].type == properties[1].type && properties[0].type == properties[2].type)
+		{
+			if(properties[0].type == PLY_FLOAT32)
 			{
-				sstrVertexNum = sstrTmpOutput.substr(0, pos1);
+				const float* block = reinterpret_cast<const float*>(pCurr);
+				vertexList.assign(block, block+3*element.count);
+				pCurr += element.count*rowSize;
+				return true;
 			}
-			else
+			else if(properties[0].type == PLY_FLOAT64)
 			{
-				sstrVertexNum = sstrTmpOutput;
+				const double* block = reinterpret_cast<const double*>(pCurr);
+				vertexList.assign(block, block+3*element.count);
+				pCurr += element.count*rowSize;
+				return true;
 			}
+		}
 
-			//const size_t pos2 = sstrTmpOutput.find_first_of("/", pos1+1);
-			//if(pos2 == std::string::npos)
-			//{
+		const int numRows = static_cast<int>(element.count);
+		int numNonTriangles(0);
 
-			//}
+#pragma omp parallel for reduction(+:numNonTriangles)
+		for(int row = 0; row < numRows; ++row)
+		{
+			const char* pRow = pCurr+row*rowSize;
+			for(size_t j = 0; j < properties.size(); ++j)
+			{
+				const PlyProperty& property = properties[j];
+				const char* pValue = pRow+offsets[j];
 
+				if(roles[j] == PLY_VERTEX_INDICES)
+				{
+					if(readPlyValue(pValue, property.countType, bSwap) != 3.0)
+					{
+						++numNonTriangles;
+						break;
+					}
+
+					const size_t countSize = getPlyTypeSize(property.countType);
+					const size_t valueSize = getPlyTypeSize(property.type);
+
+					int* polyIndices = &triangleList[3*row];
+					for(size_t k = 0; k < 3; ++k)
+					{
+						polyIndices[k] = static_cast<int>(readPlyValue(pValue+countSize+k*valueSize, property.type, bSwap));
+					}
+				}
+				else if(roles[j] != PLY_SKIP)
+				{
+					setPlyVertexValue(roles[j], property.type, readPlyValue(pValue, property.type, bSwap), row, vertexList, vertexColorList);
+				}
+			}
+		}
 
-			//sstrTexturNum = sstrTmpOutput.substr(pos1+1, pos2-pos1-1);
-			//sstrNormalNum = sstrTmpOutput.substr(pos2+1);
+		if(numNonTriangles > 0)
+		{
+			return false;
+		}
+
+		pCurr += element.count*rowSize;
+		return true;
+	}
 
-			if(sstrVertexNum.empty())
+	//Reads the rows of an ASCII element, see readBinaryPlyRows
+	bool readAsciiPlyRows(TextScanner& scanner, const PlyElement& element, const std::vector<PlyRole>& roles
+								, std::vector<double>& vertexList, std::vector<double>& vertexColorList, std::vector<int>& triangleList)
+	{
+		for(uint64_t row = 0; row < element.count; ++row)
+		{
+			for(size_t j = 0; j < element.properties.size(); ++j)
 			{
-				//delete pPoly;
+				const PlyProperty& property = element.properties[j];
+
+				uint64_t numValues(1);
+				if(property.countType != PLY_INVALID && !scanner.nextNumber(numValues))
+				{
+					return false;
+				}
+
+				if(roles[j] == PLY_VERTEX_INDICES)
+				{
+					if(numValues != 3)
+					{
+#ifdef DEBUG_OUTPUT
+						std::cout << "loadPly() - only triangles supported" << std::endl; 
+#endif
+						return false;
+					}
+
+					int* polyIndices = &triangleList[3*row];
+					if(!scanner.nextNumber(polyIndices[0]) || !scanner.nextNumber(polyIndices[1]) || !scanner.nextNumber(polyIndices[2]))
+					{
+						return false;
+					}
+
+					continue;
+				}
+
+				for(uint64_t k = 0; k < numValues; ++k)
+				{
+					double value(0.0);
+					if(!scanner.nextNumber(value))
+					{
+						return false;
+					}
+
+					setPlyVertexValue(roles[j], property.type, value, row, vertexList, vertexColorList);
+				}
+			}
+		}
+
+		return true;
+	}
+}
+
+bool FileLoader::loadPly(const std::string& sstrFileName, DataContainer& outData)
+{
+	MappedFile file;
+	if(!file.open(sstrFileName))
+	{
+		return false;
+	}
+
+	const char* data = file.getData();
+	const char* fileEnd = data+file.getSize();
+
+	PlyFormat format(PLY_ASCII);
+	std::vector<PlyElement> elements;
+	size_t dataOffset(0);
+	if(!readPlyHeader(data, fileEnd, format, elements, dataOffset))
+	{
+		*m_pLogStream << "Unsupported PLY header " << sstrFileName << std::endl;
+		return false;
+	}
+
+	//Vertices need coordinates, each face needs a vertex index list.
+	//Counts are bounded by the file size, every row has at least one byte or one token.
+	const uint64_t maxCount = std::min<uint64_t>(file.getSize(), std::numeric_limits<int>::max());
+
+	uint64_t numVertices(0);
+	uint64_t numFaces(0);
+	std::vector<std::vector<PlyRole>> elementRoles(elements.size());
+	for(size_t i = 0; i < elements.size(); ++i)
+	{
+		const PlyElement& element = elements[i];
+		const bool bMeshElement = element.sstrName == "vertex" || element.sstrName == "face";
+		if(element.count > maxCount || (bMeshElement && std::count_if(elements.begin(), elements.end(), [&](const PlyElement& other){ return other.sstrName == element.sstrName; }) > 1))
+		{
+			*m_pLogStream << "Corrupt PLY file " << sstrFileName << std::endl;
+			return false;
+		}
+
+		std::vector<PlyRole>& roles = elementRoles[i];
+		for(size_t j = 0; j < element.properties.size(); ++j)
+		{
+			roles.push_back(getPlyRole(element, element.properties[j]));
+		}
+
+		if(element.sstrName == "vertex")
+		{
+			if(std::count(roles.begin(), roles.end(), PLY_X) != 1 || std::count(roles.begin(), roles.end(), PLY_Y) != 1 || std::count(roles.begin(), roles.end(), PLY_Z) != 1)
+			{
+				*m_pLogStream << "Unsupported PLY vertices " << sstrFileName << std::endl;
 				return false;
 			}
 
-			const int vertexNum = atoi(sstrVertexNum.c_str());
-			//const int num2 = atoi(sstrTexturNum.c_str());
-			//const int num3 = atoi(sstrNormalNum.c_str());
+			numVertices = element.count;
+		}
+		else if(element.sstrName == "face")
+		{
+			if(std::count(roles.begin(), roles.end(), PLY_VERTEX_INDICES) != 1)
+			{
+				*m_pLogStream << "Unsupported PLY faces " << sstrFileName << std::endl;
+				return false;
+			}
+
+			numFaces = element.count;
+		}
+	}
+
+	if(numVertices < 1)
+	{
+		return false;
+	}
+
+	//Colors are only loaded if all three channels are given
+	bool bColors(false);
+	for(size_t i = 0; i < elements.size(); ++i)
+	{
+		const std::vector<PlyRole>& roles = elementRoles[i];
+		if(elements[i].sstrName == "vertex")
+		{
+			bColors = std::count(roles.begin(), roles.end(), PLY_RED) == 1 && std::count(roles.begin(), roles.end(), PLY_GREEN) == 1 && std::count(roles.begin(), roles.end(), PLY_BLUE) == 1;
+		}
+	}
+
+	std::vector<double> vertexList(3*numVertices);
+	std::vector<int> triangleList(3*numFaces);
+	std::vector<double> vertexColorList(bColors ? 3*numVertices : 0);
+
+	bool bRead(true);
+	if(format == PLY_ASCII)
+	{
+		TextScanner scanner(data+dataOffset, fileEnd);
+		for(size_t i = 0; i < elements.size() && bRead; ++i)
+		{
+			bRead = readAsciiPlyRows(scanner, elements[i], elementRoles[i], vertexList, vertexColorList, triangleList);
+		}
+	}
+	else
+	{
+		//Values are stored little-endian in memory
+		const bool bSwap = format == PLY_BINARY_BIG_ENDIAN;
 
-			//(*pPoly)[i] = vertexNum-1;
-			polygon.push_back(vertexNum-1);
+		const char* pCurr = data+dataOffset;
+		for(size_t i = 0; i < elements.size() && bRead; ++i)
+		{
+			if(!readBinaryPlyFixedRows(pCurr, fileEnd, elements[i], elementRoles[i], bSwap, vertexList, vertexColorList, triangleList))
+			{
+				bRead = readBinaryPlyRows(pCurr, fileEnd, elements[i], elementRoles[i], bSwap, vertexList, vertexColorList, triangleList);
+			}
 		}
+	}
 
-		//vertexIndexList.push_back(pPoly);
-		vertexIndexList.push_back(polygon);
-		bEnd = readNextNode(pFile, output);
+	if(!bRead)
+	{
+		*m_pLogStream << "Corrupt PLY file " << sstrFileName << std::endl;
+		return false;
 	}
 
-	outData.setVertexList(vertexList);
-	outData.setVertexIndexList(vertexIndexList);
-	outData.setVertexColorList(vertexColors);
+	if(!hasValidIndices(triangleList, numVertices))
+	{
+		*m_pLogStream << "Corrupt PLY file " << sstrFileName << std::endl;
+		return false;
+	}
 
-	return fclose(pFile)==0;
+	if(!outData.setVertexList(std::move(vertexList)))
+	{
+		return false;
+	}
+
+	outData.setTriangleList(std::move(triangleList));
+	outData.setVertexColorList(std::move(vertexColorList));
+	return true;
 }
 
 bool FileLoader::readNextNode(FILE* pFile, char* cstrOutput)
@@ -634,7 +1562,7 @@ bool FileLoader::readNextNode(FILE* pFile, char* cstrOutput)
 				if(currChar == EOF)
 				{
 					//Failed pushing bracket back into stream
-					std::cout << "Failed pushing back bracket into stream" << std::endl;
+					*m_pLogStream << "Failed pushing back bracket into stream" << std::endl;
 					return true;
 				}
 				else
@@ -696,7 +1624,7 @@ bool FileLoader::processShapeNode(FILE* pFile, char* cstrOutput, DataContainer&
 		{
 			std::vector<double> vertexList;
 			processCoordinates(pFile, cstrOutput, 3, vertexList);
-			outPoly.setVertexList(vertexList);
+			outPoly.setVertexList(std::move(vertexList));
 		}
 		
 		if(!bEnd && isEqual(cstrOutput, "coordIndex"))
@@ -30,6 +30,11 @@ class FileLoader
 	};
 
 public:
+	FileLoader();
+
+	//! Messages of the loading are written to the log stream, std::cout by default
+	void setLogStream(std::ostream& logStream);
+
 	static std::string getFileExtension(const std::string& sstrFileName);
 
 	static bool fileExist(const std::string& sstrFileName);
@@ -49,6 +54,12 @@ private:
 
 	bool loadObj(const std::string& sstrFileName, DataContainer& outData);
 
+	//! Loads a binary mesh (see BinaryMesh.h) from its memory mapping, the blocks are copied as a whole without parsing
+	bool loadBinaryMesh(const std::string& sstrFileName, DataContainer& outData);
+
+	//! Loads vertices with optional colors and triangles of an ASCII or binary PLY file, binary rows are read from the memory mapping without parsing
+	bool loadPly(const std::string& sstrFileName, DataContainer& outData);
+
 	bool readNextNode(FILE* pFile, char* cstrOutput);
 
 	//! return true if successful, false if not successful or eof is reached
@@ -315,6 +326,8 @@ private:
 	{
 		return strcmp(cstrS1, cstrS2) == 0;
 	}
+
+	std::ostream* m_pLogStream;
 };
 
 #endif
\ No newline at end of file
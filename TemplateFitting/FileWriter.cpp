@@ -13,6 +13,7 @@
 
 #include "FileWriter.h"
 #include "FileLoader.h"
+#include "BinaryMesh.h"
 
 #ifdef _WIN32
 #include <direct.h> 
@@ -22,6 +23,10 @@
 
 #include <vector>
 #include <fstream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <charconv>
 
 void FileWriter::makeDirectory(const std::string& sstrPath)
 {
@@ -64,6 +69,14 @@ bool FileWriter::saveFile(const std::string& sstrFileName, const DataContainer&
 	{
 		return FileWriter::writeWrl(sstrFileName, data);
 	}
+	else if(suffix==std::string("bmsh"))
+	{
+		return FileWriter::writeBinaryMesh(sstrFileName, data);
+	}
+	else if(suffix==std::string("ply"))
+	{
+		return FileWriter::writeBinaryPly(sstrFileName, data);
+	}
 	else if(suffix==std::string("pset"))
 	{
 		return false;
@@ -72,6 +85,213 @@ bool FileWriter::saveFile(const std::string& sstrFileName, const DataContainer&
 	return false;
 }
 
+namespace
+{
+	//Writes the values converted to Scalar as one block
+	template<typename Scalar>
+	void writeBinaryBlock(const std::vector<double>& values, std::fstream& output)
+	{
+		std::vector<Scalar> block(values.begin(), values.end());
+		if(!block.empty())
+		{
+			output.write(reinterpret_cast<const char*>(&block[0]), block.size()*sizeof(Scalar));
+		}
+	}
+
+	//Pads the output with zeros to the next multiple of 8 bytes
+	void writeBinaryPadding(const uint64_t size, std::fstream& output)
+	{
+		const char padding[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+		output.write(padding, static_cast<std::streamsize>((8-size%8)%8));
+	}
+}
+
+bool FileWriter::writeBinaryMesh(const std::string& sstrFileName, const DataContainer& data, const bool bFloat32)
+{
+	if(sstrFileName.empty())
+	{
+		return false;
+	}
+
+	const std::vector<double>& vertices = data.getVertexList();
+	const std::vector<double>& vertexColors = data.getVertexColorList();
+
+	//Non-negative int indices have the same representation as the uint32 indices of the file
+	const std::vector<int>& triangles = data.getTriangleList();
+
+	const uint64_t numVertices = data.getNumVertices();
+	const uint64_t numTriangles = data.getNumFaces();
+
+	const bool bValidColors = !vertices.empty() && vertices.size() == vertexColors.size();
+	const uint64_t scalarSize = bFloat32 ? sizeof(float) : sizeof(double);
+
+	BinaryMeshHeader header;
+	memcpy(header.magic, BINARY_MESH_MAGIC, sizeof(header.magic));
+	header.version = BINARY_MESH_VERSION;
+	header.flags = (bFloat32 ? BINARY_MESH_FLOAT32 : 0) | (bValidColors ? BINARY_MESH_COLORS : 0);
+	header.reserved = 0;
+	header.numVertices = numVertices;
+	header.numTriangles = numTriangles;
+
+	const uint64_t vertexBlockSize = 3*numVertices*scalarSize;
+	const uint64_t triangleBlockSize = 3*numTriangles*sizeof(uint32_t);
+	header.vertexOffset = sizeof(BinaryMeshHeader);
+	header.triangleOffset = header.vertexOffset + vertexBlockSize + (8-vertexBlockSize%8)%8;
+	header.colorOffset = bValidColors ? header.triangleOffset + triangleBlockSize + (8-triangleBlockSize%8)%8 : 0;
+
+	std::fstream output;
+	output.open(sstrFileName.c_str(), std::ios::out | std::ios::binary);
+	if(!output.is_open())
+	{
+		return false;
+	}
+
+	output.write(reinterpret_cast<const char*>(&header), sizeof(BinaryMeshHeader));
+
+	if(bFloat32)
+	{
+		writeBinaryBlock<float>(vertices, output);
+	}
+	else
+	{
+		writeBinaryBlock<double>(vertices, output);
+	}
+	writeBinaryPadding(vertexBlockSize, output);
+
+	if(!triangles.empty())
+	{
+		output.write(reinterpret_cast<const char*>(&triangles[0]), triangleBlockSize);
+	}
+
+	if(bValidColors)
+	{
+		writeBinaryPadding(triangleBlockSize, output);
+		if(bFloat32)
+		{
+			writeBinaryBlock<float>(vertexColors, output);
+		}
+		else
+		{
+			writeBinaryBlock<double>(vertexColors, output);
+		}
+	}
+
+	output.close();
+	return !output.fail();
+}
+
+namespace
+{
+	//Stores the vertex coordinates of the PLY vertex rows as Scalar
+	template<typename Scalar>
+	void writePlyCoordinates(const std::vector<double>& vertices, const size_t rowSize, std::vector<char>& block)
+	{
+		const int numVertices = static_cast<int>(vertices.size()/3);
+
+#pragma omp parallel for
+		for(int i = 0; i < numVertices; ++i)
+		{
+			const Scalar coords[3] = {static_cast<Scalar>(vertices[3*i]), static_cast<Scalar>(vertices[3*i+1]), static_cast<Scalar>(vertices[3*i+2])};
+			memcpy(&block[i*rowSize], coords, sizeof(coords));
+		}
+	}
+}
+
+bool FileWriter::writeBinaryPly(const std::string& sstrFileName, const DataContainer& data, const bool bFloat32)
+{
+	if(sstrFileName.empty())
+	{
+		return false;
+	}
+
+	const std::vector<double>& vertices = data.getVertexList();
+	const std::vector<double>& vertexColors = data.getVertexColorList();
+	const std::vector<int>& triangles = data.getTriangleList();
+
+	const size_t numVertices = data.getNumVertices();
+	const size_t numFaces = data.getNumFaces();
+
+	const bool bValidColors = !vertices.empty() && vertices.size() == vertexColors.size();
+	const size_t scalarSize = bFloat32 ? sizeof(float) : sizeof(double);
+
+	//Vertex rows hold the coordinates followed by uchar colors
+	const size_t vertexRowSize = 3*scalarSize + (bValidColors ? 3 : 0);
+	std::vector<char> vertexBlock(numVertices*vertexRowSize);
+	if(bFloat32)
+	{
+		writePlyCoordinates<float>(vertices, vertexRowSize, vertexBlock);
+	}
+	else
+	{
+		writePlyCoordinates<double>(vertices, vertexRowSize, vertexBlock);
+	}
+
+	if(bValidColors)
+	{
+#pragma omp parallel for
+		for(int i = 0; i < static_cast<int>(numVertices); ++i)
+		{
+			for(size_t j = 0; j < 3; ++j)
+			{
+				const double color = std::min(std::max(vertexColors[3*i+j], 0.0), 1.0);
+				vertexBlock[i*vertexRowSize+3*scalarSize+j] = static_cast<char>(static_cast<unsigned char>(color*255.0+0.5));
+			}
+		}
+	}
+
+	//Face rows hold the uchar number of indices (always 3) followed by the int indices
+	const size_t faceRowSize = 1+3*sizeof(int32_t);
+	std::vector<char> faceBlock(numFaces*faceRowSize);
+
+#pragma omp parallel for
+	for(int i = 0; i < static_cast<int>(numFaces); ++i)
+	{
+		char* pRow = &faceBlock[i*faceRowSize];
+		pRow[0] = 3;
+		memcpy(pRow+1, &triangles[3*i], 3*sizeof(int32_t));
+	}
+
+	std::fstream output;
+	output.open(sstrFileName.c_str(), std::ios::out | std::ios::binary);
+	if(!output.is_open())
+	{
+		return false;
+	}
+
+	const char* cstrScalarType = bFloat32 ? "float" : "double";
+
+	output << "ply\n"
+			<< "format binary_little_endian 1.0\n"
+			<< "element vertex " << numVertices << "\n"
+			<< "property " << cstrScalarType << " x\n"
+			<< "property " << cstrScalarType << " y\n"
+			<< "property " << cstrScalarType << " z\n";
+
+	if(bValidColors)
+	{
+		output << "property uchar red\n"
+				<< "property uchar green\n"
+				<< "property uchar blue\n";
+	}
+
+	output << "element face " << numFaces << "\n"
+			<< "property list uchar int vertex_indices\n"
+			<< "end_header\n";
+
+	if(!vertexBlock.empty())
+	{
+		output.write(&vertexBlock[0], vertexBlock.size());
+	}
+
+	if(!faceBlock.empty())
+	{
+		output.write(&faceBlock[0], faceBlock.size());
+	}
+
+	output.close();
+	return !output.fail();
+}
+
 bool FileWriter::saveFile(const std::string& sstrFileName, const DataContainer& data, const std::vector<double>& addPoints, const std::vector<double>& addColors)
 {
 	if(sstrFileName.empty())
@@ -512,6 +732,80 @@ bool FileWriter::saveThinPlateSpline(const std::string& sstrFileName, const std:
 	return true;
 }
 
+namespace
+{
+	//Number of vertices or faces formatted into one text buffer
+	const size_t TEXT_CHUNK_SIZE = 16384;
+
+	//Number of text buffers formatted in parallel before they are written, bounds the buffered text to a few ten MB
+	const size_t TEXT_CHUNKS_PER_PASS = 64;
+
+	//Appends the value in fixed notation with 7 digits after the decimal point, identical to the stream output with precision 7 and std::ios::fixed
+	void appendDouble(const double value, std::string& buffer)
+	{
+		//Large enough for the fixed notation of any double
+		char text[512];
+		const std::to_chars_result result = std::to_chars(text, text+sizeof(text), value, std::chars_format::fixed, 7);
+		buffer.append(text, result.ptr);
+	}
+
+	template<typename Integer>
+	void appendInteger(const Integer value, std::string& buffer)
+	{
+		char text[32];
+		const std::to_chars_result result = std::to_chars(text, text+sizeof(text), value);
+		buffer.append(text, result.ptr);
+	}
+
+	//Formats the items 0..numItems-1 by formatItem(i, buffer) into chunks of TEXT_CHUNK_SIZE items in parallel and writes the chunks in order, one write call per chunk
+	template<typename FormatItem>
+	void writeFormattedItems(const size_t numItems, const FormatItem& formatItem, std::fstream& output)
+	{
+		const size_t numChunks = (numItems+TEXT_CHUNK_SIZE-1)/TEXT_CHUNK_SIZE;
+		std::vector<std::string> buffers(std::min(numChunks, TEXT_CHUNKS_PER_PASS));
+
+		for(size_t passBegin = 0; passBegin < numChunks; passBegin += TEXT_CHUNKS_PER_PASS)
+		{
+			const int numPassChunks = static_cast<int>(std::min(TEXT_CHUNKS_PER_PASS, numChunks-passBegin));
+
+#pragma omp parallel for schedule(dynamic)
+			for(int i = 0; i < numPassChunks; ++i)
+			{
+				const size_t begin = (passBegin+i)*TEXT_CHUNK_SIZE;
+				const size_t end = std::min(begin+TEXT_CHUNK_SIZE, numItems);
+
+				//Buffers keep their capacity over the passes
+				std::string& buffer = buffers[i];
+				buffer.clear();
+				for(size_t j = begin; j < end; ++j)
+				{
+					formatItem(j, buffer);
+				}
+			}
+
+			for(int i = 0; i < numPassChunks; ++i)
+			{
+				output.write(buffers[i].data(), static_cast<std::streamsize>(buffers[i].size()));
+			}
+		}
+	}
+
+	//Formats the polygons as comma separated indices terminated by -1 as used by the VRML index lists
+	void writeWrlIndexList(const std::vector<std::vector<int>>& indexList, std::fstream& output)
+	{
+		writeFormattedItems(indexList.size(), [&](const size_t i, std::string& buffer)
+		{
+			const std::vector<int>& currIndices = indexList[i];
+			for(size_t j = 0; j < currIndices.size(); ++j)
+			{
+				appendInteger(currIndices[j], buffer);
+				buffer.append(", ");
+			}
+			buffer.append("-1\n");
+		}, output);
+	}
+}
+
 bool FileWriter::writeOff(const std::string& sstrFileName, const DataContainer& data)
 {
 	if(sstrFileName.empty())
@@ -520,7 +814,7 @@ bool FileWriter::writeOff(const std::string& sstrFileName, const DataContainer&
 	}
 
 	const size_t numVertices = data.getNumVertices();
-	const size_t numFaces = data.getVertexIndexList().size();
+	const size_t numFaces = data.getNumFaces();
 	const size_t numEdges = 0;
 
 	const char* cstrFileName = sstrFileName.c_str();
@@ -531,8 +825,10 @@ bool FileWriter::writeOff(const std::string& sstrFileName, const DataContainer&
 
 	std::fstream output;
 	output.open(cstrFileName, std::ios::out);
-	output.precision(7);
-	output.setf(std::ios::fixed,std::ios::floatfield);
+	if(!output.is_open())
+	{
+		return false;
+	}
 
 	const std::vector<double>& vertices = data.getVertexList();
 	const std::vector<double>& vertexColors = data.getVertexColorList();
@@ -541,40 +837,51 @@ bool FileWriter::writeOff(const std::string& sstrFileName, const DataContainer&
 
 	if(bValidColors)
 	{
-		output << "COFF" << std::endl;
+		output << "COFF\n";
 	}
 	else
 	{
-		output << "OFF" << std::endl;
+		output << "OFF\n";
 	}
 
-	output << numVertices << " " << numFaces << " " << numEdges << std::endl;
+	output << numVertices << " " << numFaces << " " << numEdges << "\n";
 
-	for(size_t i = 0; i < numVertices; ++i)
+	writeFormattedItems(numVertices, [&](const size_t i, std::string& buffer)
 	{
-		output << vertices[3*i] << " " << vertices[3*i+1] << " " << vertices[3*i+2] << " ";
+		appendDouble(vertices[3*i], buffer);
+		buffer.push_back(' ');
+		appendDouble(vertices[3*i+1], buffer);
+		buffer.push_back(' ');
+		appendDouble(vertices[3*i+2], buffer);
+		buffer.push_back(' ');
+
 		if(bValidColors)
 		{
-			output << vertexColors[3*i] << " " << vertexColors[3*i+1] << " " << vertexColors[3*i+2] << " " << "1.0";
+			appendDouble(vertexColors[3*i], buffer);
+			buffer.push_back(' ');
+			appendDouble(vertexColors[3*i+1], buffer);
+			buffer.push_back(' ');
+			appendDouble(vertexColors[3*i+2], buffer);
+			buffer.append(" 1.0");
 		}
 
-		output << std::endl;
-	}
+		buffer.push_back('\n');
+	}, output);
 
-	const std::vector<std::vector<int>>& vertexIndexList = data.getVertexIndexList();
-	for(size_t i = 0; i < vertexIndexList.size(); ++i)
+	const std::vector<int>& triangles = data.getTriangleList();
+	writeFormattedItems(numFaces, [&](const size_t i, std::string& buffer)
 	{
-		const std::vector<int>& currPolyIndices = vertexIndexList[i];
-		output << currPolyIndices.size() << " ";
-		for(size_t j = 0; j < currPolyIndices.size(); ++j)
+		buffer.append("3 ");
+		for(size_t j = 0; j < 3; ++j)
 		{
-			output << currPolyIndices[j] << " ";
+			appendInteger(triangles[3*i+j], buffer);
+			buffer.push_back(' ');
 		}
-		output << std::endl;
-	}
+		buffer.push_back('\n');
+	}, output);
 
 	output.close();
-	return true;
+	return !output.fail();
 }
 
 bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer& data)
@@ -592,10 +899,12 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 
 	std::fstream output;
 	output.open(cstrFileName, std::ios::out);
-	output.precision(7);
-	output.setf(std::ios::fixed,std::ios::floatfield);
+	if(!output.is_open())
+	{
+		return false;
+	}
 
-	output << "#VRML V2.0 utf8" << std::endl;
+	output << "#VRML V2.0 utf8\n";
  
 	output << "Transform {\n"
 			<< "children [\n"
@@ -608,7 +917,7 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 				<< "texture ImageTexture {\n"
 				<< "url ";
 				
-		output << "\"" << sstrTextureName << "\"" << std::endl;
+		output << "\"" << sstrTextureName << "\"\n";
 
 		output << "} #ImageTexture\n"
 			<< "} #Appearance\n";
@@ -623,10 +932,15 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 				<< "point [\n";
 
 		const std::vector<double>& vertices = data.getVertexList();
-		for(size_t i = 0; i < numVertices; ++i)
+		writeFormattedItems(numVertices, [&](const size_t i, std::string& buffer)
 		{
-			output << vertices[3*i] << " " <<  vertices[3*i+1] << " " << vertices[3*i+2] << "," << std::endl;
-		}
+			appendDouble(vertices[3*i], buffer);
+			buffer.push_back(' ');
+			appendDouble(vertices[3*i+1], buffer);
+			buffer.push_back(' ');
+			appendDouble(vertices[3*i+2], buffer);
+			buffer.append(",\n");
+		}, output);
 
 		output << "] #point\n"
 			<< "} #Coordinate\n";
@@ -637,16 +951,16 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 	{
 		output << "coordIndex [\n";
 
-		const std::vector<std::vector<int>>& vertexIndexList = data.getVertexIndexList();
-		for(size_t i = 0; i < numFaces; ++i)
+		const std::vector<int>& triangles = data.getTriangleList();
+		writeFormattedItems(numFaces, [&](const size_t i, std::string& buffer)
 		{
-			const std::vector<int>& currFaceIndices = vertexIndexList[i];
-			for(size_t j = 0; j < currFaceIndices.size(); ++j)
+			for(size_t j = 0; j < 3; ++j)
 			{
-				output << currFaceIndices[j] << ", ";
+				appendInteger(triangles[3*i+j], buffer);
+				buffer.append(", ");
 			}
-			output << "-1" << std::endl;
-		}
+			buffer.append("-1\n");
+		}, output);
 
 		output << "] #coordIndex\n";
 	}
@@ -657,11 +971,15 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 		output << "color Color {\n"
 				<< "color [\n";
 
-		const size_t numVertexColors = vertexColorList.size()/3;
-		for(size_t i = 0; i < numVertexColors; ++i)
+		writeFormattedItems(vertexColorList.size()/3, [&](const size_t i, std::string& buffer)
 		{
-			output << vertexColorList[3*i] << " " <<  vertexColorList[3*i+1] << " " << vertexColorList[3*i+2] << std::endl;
-		}
+			appendDouble(vertexColorList[3*i], buffer);
+			buffer.push_back(' ');
+			appendDouble(vertexColorList[3*i+1], buffer);
+			buffer.push_back(' ');
+			appendDouble(vertexColorList[3*i+2], buffer);
+			buffer.push_back('\n');
+		}, output);
 
 		output << "] #color\n"
 			<< "} #Color\n";
@@ -673,11 +991,13 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 		output << "texCoord TextureCoordinate {\n"
 				<< "point [\n";
 
-		const size_t numTextureCoords = textureList.size()/2;
-		for(size_t i = 0; i < numTextureCoords; ++i)
+		writeFormattedItems(textureList.size()/2, [&](const size_t i, std::string& buffer)
 		{
-			output << textureList[2*i] << " " <<  textureList[2*i+1] << std::endl;
-		}
+			appendDouble(textureList[2*i], buffer);
+			buffer.push_back(' ');
+			appendDouble(textureList[2*i+1], buffer);
+			buffer.push_back('\n');
+		}, output);
 
 		output << "] #point\n"
 				<< "} #TextureCoordinate\n";
@@ -688,16 +1008,7 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 	{
 		output << "texCoordIndex [\n";
 		
-		for(size_t i = 0; i < textureIndexList.size(); ++i)
-		{
-			const std::vector<int>& currTextureIndices = textureIndexList[i];
-			for(size_t j = 0; j < currTextureIndices.size(); ++j)
-			{
-				output << currTextureIndices[j] << ", ";
-			}
-
-			output << "-1" << std::endl;
-		}
+		writeWrlIndexList(textureIndexList, output);
 
 		output << "] #texCoordIndex\n";
 	}
@@ -709,7 +1020,7 @@ bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer&
 		<< "} #Transform\n";
 
 	output.close();
-	return true;
+	return !output.fail();
 }
 
 bool FileWriter::writeWrl(const std::string& sstrFileName, const DataContainer& data, const std::vector<double>& addPoints, const std::vector<double>& addColors)
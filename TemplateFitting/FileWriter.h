@@ -29,6 +29,12 @@ public:
 
 	static bool saveFile(const std::string& sstrFileName, const DataContainer& data);
 
+	//! Writes a triangle mesh in the binary mesh format (see BinaryMesh.h), with float32 instead of float64 vertices and colors if bFloat32 is set
+	static bool writeBinaryMesh(const std::string& sstrFileName, const DataContainer& data, const bool bFloat32 = false);
+
+	//! Writes a mesh as binary little-endian PLY file with double (or float if bFloat32 is set) coordinates, uchar colors and int vertex index lists
+	static bool writeBinaryPly(const std::string& sstrFileName, const DataContainer& data, const bool bFloat32 = false);
+
 	static bool saveLandmarks(const std::string& sstrFileName, const std::vector<double>& landmarks, const std::vector<bool>& valid);
 
 	static bool saveMultilinearModel(const std::string& sstrFileName, std::vector<size_t>& modeDims, std::vector<size_t>& truncModeDims, std::vector<double>& multModel
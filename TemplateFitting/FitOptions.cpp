@@ -0,0 +1,247 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "FitOptions.h"
+
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <stdlib.h>
+
+namespace
+{
+	bool parseDouble(const std::string& sstrValue, double& value)
+	{
+		char* pEnd(NULL);
+		value = strtod(sstrValue.c_str(), &pEnd);
+		return !sstrValue.empty() && pEnd != NULL && *pEnd == '\0';
+	}
+
+	bool parseSize(const std::string& sstrValue, size_t& value)
+	{
+		char* pEnd(NULL);
+		const long tmpValue = strtol(sstrValue.c_str(), &pEnd, 10);
+		value = tmpValue > 0 ? static_cast<size_t>(tmpValue) : 0;
+		return !sstrValue.empty() && pEnd != NULL && *pEnd == '\0' && tmpValue >= 0;
+	}
+}
+
+FitOptions::FitOptions()
+: nnWeight(NN_WEIGHT)
+, regWeight(REG_WEIGHT)
+, rigidWeight(RIGID_WEIGHT)
+, maxNumIter(MAX_NUM_ITER)
+, convergenceCorrespondenceChange(CONVERGENCE_CORRESPONDENCE_CHANGE)
+, convergenceEnergyDecrease(CONVERGENCE_ENERGY_DECREASE)
+, convergenceMaxDisplacement(CONVERGENCE_MAX_DISPLACEMENT)
+, maxNNDist(MAX_NN_DIST)
+, maxAngle(MAX_ANGLE)
+, precision(FIT_PRECISION)
+, bVerbose(true)
+{
+
+}
+
+bool FitOptions::setParameter(const std::string& sstrName, const std::string& sstrValue)
+{
+	bool bValid(false);
+	if(sstrName == "nnWeight")
+	{
+		bValid = parseDouble(sstrValue, nnWeight);
+	}
+	else if(sstrName == "regWeight")
+	{
+		bValid = parseDouble(sstrValue, regWeight);
+	}
+	else if(sstrName == "rigidWeight")
+	{
+		bValid = parseDouble(sstrValue, rigidWeight);
+	}
+	else if(sstrName == "maxNumIter")
+	{
+		bValid = parseSize(sstrValue, maxNumIter);
+	}
+	else if(sstrName == "convergenceCorrespondenceChange")
+	{
+		bValid = parseDouble(sstrValue, convergenceCorrespondenceChange);
+	}
+	else if(sstrName == "convergenceEnergyDecrease")
+	{
+		bValid = parseDouble(sstrValue, convergenceEnergyDecrease);
+	}
+	else if(sstrName == "convergenceMaxDisplacement")
+	{
+		bValid = parseDouble(sstrValue, convergenceMaxDisplacement);
+	}
+	else if(sstrName == "maxNNDist")
+	{
+		bValid = parseDouble(sstrValue, maxNNDist);
+	}
+	else if(sstrName == "maxAngle")
+	{
+		bValid = parseDouble(sstrValue, maxAngle);
+	}
+	else if(sstrName == "precision")
+	{
+		bValid = sstrValue == "float" || sstrValue == "double";
+		precision = sstrValue == "float" ? PRECISION_FLOAT : PRECISION_DOUBLE;
+	}
+	else
+	{
+		std::cout << "Unknown parameter " << sstrName << std::endl;
+		return false;
+	}
+
+	if(!bValid)
+	{
+		std::cout << "Invalid value " << sstrValue << " of parameter " << sstrName << std::endl;
+	}
+
+	return bValid;
+}
+
+std::string FitOptions::toString() const
+{
+	std::stringstream stream;
+	stream << "nnWeight " << nnWeight 
+		<< " regWeight " << regWeight 
+		<< " rigidWeight " << rigidWeight 
+		<< " maxNumIter " << maxNumIter 
+		<< " convergenceCorrespondenceChange " << convergenceCorrespondenceChange 
+		<< " convergenceEnergyDecrease " << convergenceEnergyDecrease 
+		<< " convergenceMaxDisplacement " << convergenceMaxDisplacement 
+		<< " maxNNDist " << maxNNDist 
+		<< " maxAngle " << maxAngle 
+		<< " precision " << (precision == PRECISION_FLOAT ? "float" : "double");
+	return stream.str();
+}
+
+bool FitOptions::addParameter(const std::string& sstrName, const std::string& sstrValues, ParameterValues& parameterValues)
+{
+	std::vector<std::string> values;
+
+	std::stringstream stream(sstrValues);
+	std::string sstrValue;
+	while(std::getline(stream, sstrValue, ','))
+	{
+		if(!sstrValue.empty())
+		{
+			values.push_back(sstrValue);
+		}
+	}
+
+	if(values.empty())
+	{
+		std::cout << "No value of parameter " << sstrName << std::endl;
+		return false;
+	}
+
+	parameterValues.push_back(std::make_pair(sstrName, values));
+	return true;
+}
+
+bool FitOptions::loadParameterFile(const std::string& sstrFileName, ParameterValues& parameterValues)
+{
+	std::ifstream file(sstrFileName.c_str());
+	if(!file.is_open())
+	{
+		std::cout << "Unable to open parameter file " << sstrFileName << std::endl;
+		return false;
+	}
+
+	std::string sstrLine;
+	while(std::getline(file, sstrLine))
+	{
+		const size_t commentPos = sstrLine.find('#');
+		if(commentPos != std::string::npos)
+		{
+			sstrLine.erase(commentPos);
+		}
+
+		//Values may be separated by commas or blanks
+		std::stringstream lineStream(sstrLine);
+		std::string sstrName;
+		if(!(lineStream >> sstrName))
+		{
+			continue;
+		}
+
+		std::string sstrValues;
+		std::string sstrValue;
+		while(lineStream >> sstrValue)
+		{
+			sstrValues += sstrValues.empty() ? sstrValue : "," + sstrValue;
+		}
+
+		if(!addParameter(sstrName, sstrValues, parameterValues))
+		{
+			std::cout << "Invalid line in parameter file " << sstrFileName << ": " << sstrLine << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool FitOptions::createOptionSets(const ParameterValues& parameterValues, std::vector<FitOptions>& optionSets)
+{
+	optionSets.assign(1, FitOptions());
+
+	//Each parameter multiplies the option sets by its number of values, a later parameter of the same name replaces the previous values
+	for(size_t i = 0; i < parameterValues.size(); ++i)
+	{
+		const std::string& sstrName = parameterValues[i].first;
+		const std::vector<std::string>& values = parameterValues[i].second;
+
+		bool bOverridden(false);
+		for(size_t j = i+1; j < parameterValues.size(); ++j)
+		{
+			bOverridden = bOverridden || parameterValues[j].first == sstrName;
+		}
+
+		if(bOverridden)
+		{
+			FitOptions options;
+			for(size_t k = 0; k < values.size(); ++k)
+			{
+				if(!options.setParameter(sstrName, values[k]))
+				{
+					return false;
+				}
+			}
+
+			continue;
+		}
+
+		std::vector<FitOptions> newOptionSets;
+		newOptionSets.reserve(optionSets.size()*values.size());
+
+		for(size_t j = 0; j < optionSets.size(); ++j)
+		{
+			for(size_t k = 0; k < values.size(); ++k)
+			{
+				FitOptions options(optionSets[j]);
+				if(!options.setParameter(sstrName, values[k]))
+				{
+					return false;
+				}
+
+				newOptionSets.push_back(options);
+			}
+		}
+
+		optionSets.swap(newOptionSets);
+	}
+
+	return true;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef FITOPTIONS_H
+#define FITOPTIONS_H
+
+#include "Definitions.h"
+
+#include <vector>
+#include <string>
+#include <utility>
+
+//! Run-time parameters of the template fitting, initialized with the defaults of Definitions.h.
+//! Parameters are set by name, either from a parameter file or from the command line. 
+//! A parameter given with several values spans a grid of option sets, which is fitted as parameter sweep.
+struct FitOptions
+{
+	//! List of parameter names with one or more values each, later entries override earlier ones of the same name
+	typedef std::vector<std::pair<std::string, std::vector<std::string>>> ParameterValues;
+
+	FitOptions();
+
+	//! Set a single parameter.
+	//! \param sstrName			parameter name, one of nnWeight, regWeight, rigidWeight, maxNumIter, convergenceCorrespondenceChange, 
+	//!								convergenceEnergyDecrease, convergenceMaxDisplacement, maxNNDist, maxAngle, precision
+	//! \param sstrValue			parameter value, precision is either float or double
+	//! \return false for unknown names or invalid values
+	bool setParameter(const std::string& sstrName, const std::string& sstrValue);
+
+	//! Parameters as blank separated name value pairs, in the format of a parameter file line each
+	std::string toString() const;
+
+	//! Append a parameter with comma separated values.
+	//! \return false if no value is given
+	static bool addParameter(const std::string& sstrName, const std::string& sstrValues, ParameterValues& parameterValues);
+
+	//! Load a parameter file. Each line contains a parameter name followed by comma separated values, # starts a comment.
+	//! \return false if the file cannot be read or contains an invalid line
+	static bool loadParameterFile(const std::string& sstrFileName, ParameterValues& parameterValues);
+
+	//! Apply the parameters to the default options, one option set for each combination of parameter values.
+	//! \return false for unknown parameter names or invalid values
+	static bool createOptionSets(const ParameterValues& parameterValues, std::vector<FitOptions>& optionSets);
+
+	//Weight of the nearest neighbor energy
+	double nnWeight;
+
+	//Start weights of the regularization and rigid energy, halved in every iteration
+	double regWeight;
+	double rigidWeight;
+
+	//Maximum number of iterations
+	size_t maxNumIter;
+
+	//Thresholds of the early stop before maxNumIter iterations, the fraction of changed correspondences, 
+	//the relative energy decrease and the maximum vertex displacement of an iteration must all be below them
+	double convergenceCorrespondenceChange;
+	double convergenceEnergyDecrease;
+	double convergenceMaxDisplacement;
+
+	//Maximum valid distance and angle of a template vertex to its nearest neighbor
+	double maxNNDist;
+	double maxAngle;
+
+	//Storage precision of the nearest neighbor search and the fitting energy
+	Precision precision;
+
+	//Print the progress of the iterations
+	bool bVerbose;
+};
+
+#endif
\ No newline at end of file
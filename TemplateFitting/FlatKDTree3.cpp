@@ -0,0 +1,337 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "FlatKDTree3.h"
+
+#include <algorithm>
+#include <float.h>
+
+namespace
+{
+	//Pending subtree of a query together with a lower bound of the squared distance of its points
+	struct StackEntry
+	{
+		size_t node;
+		size_t begin;
+		size_t end;
+		double minSqrDist;
+	};
+
+	//Sufficient for the depth of any tree with less than 2^32 points
+	const size_t MAX_STACK_SIZE = 64;
+
+	struct CoordinateLess
+	{
+		CoordinateLess(const std::vector<double>& points, const size_t dim)
+		: m_points(points), m_dim(dim)
+		{}
+
+		bool operator()(const int i1, const int i2) const
+		{
+			return m_points[3*i1+m_dim] < m_points[3*i2+m_dim];
+		}
+
+		const std::vector<double>& m_points;
+		const size_t m_dim;
+	};
+
+	//Point range of the node with the given position within its level
+	void getNodeRange(const size_t level, const size_t levelPosition, const size_t numPoints, size_t& begin, size_t& end)
+	{
+		begin = 0;
+		end = numPoints;
+		for(size_t i = 0; i < level; ++i)
+		{
+			const size_t mid = begin+(end-begin)/2;
+			if((levelPosition >> (level-1-i)) & 1)
+			{
+				begin = mid;
+			}
+			else
+			{
+				end = mid;
+			}
+		}
+	}
+}
+
+template<typename Scalar>
+FlatKDTree3<Scalar>::FlatKDTree3(const std::vector<double>& points)
+: m_depth(0)
+, m_numInnerNodes(0)
+{
+	const size_t numPoints = points.size()/3;
+
+	//Choose the number of levels such that no leaf holds more than LEAF_SIZE points
+	size_t numLeaves = 1;
+	while(numLeaves*LEAF_SIZE < numPoints)
+	{
+		numLeaves *= 2;
+		++m_depth;
+	}
+
+	m_numInnerNodes = numLeaves-1;
+	m_splitDims.resize(m_numInnerNodes, 0);
+	m_splitValues.resize(m_numInnerNodes, 0.0);
+
+	std::vector<int> order(numPoints);
+	for(size_t i = 0; i < numPoints; ++i)
+	{
+		order[i] = static_cast<int>(i);
+	}
+
+	//Nodes of the same level cover disjoint point ranges and are split in parallel
+	for(size_t level = 0; level < m_depth; ++level)
+	{
+		const size_t firstLevelNode = (static_cast<size_t>(1) << level)-1;
+		const int numLevelNodes = static_cast<int>(static_cast<size_t>(1) << level);
+
+#pragma omp parallel for
+		for(int i = 0; i < numLevelNodes; ++i)
+		{
+			size_t begin(0);
+			size_t end(0);
+			getNodeRange(level, i, numPoints, begin, end);
+
+			//Split along the dimension of largest extent
+			double minValues[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+			double maxValues[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+			for(size_t j = begin; j < end; ++j)
+			{
+				for(size_t d = 0; d < 3; ++d)
+				{
+					const double value = points[3*order[j]+d];
+					minValues[d] = std::min(minValues[d], value);
+					maxValues[d] = std::max(maxValues[d], value);
+				}
+			}
+
+			size_t splitDim(0);
+			for(size_t d = 1; d < 3; ++d)
+			{
+				splitDim = maxValues[d]-minValues[d] > maxValues[splitDim]-minValues[splitDim] ? d : splitDim;
+			}
+
+			const size_t mid = begin+(end-begin)/2;
+			std::nth_element(order.begin()+begin, order.begin()+mid, order.begin()+end, CoordinateLess(points, splitDim));
+
+			const size_t node = firstLevelNode+i;
+			m_splitDims[node] = static_cast<unsigned char>(splitDim);
+			m_splitValues[node] = static_cast<Scalar>(points[3*order[mid]+splitDim]);
+		}
+	}
+
+	m_x.resize(numPoints);
+	m_y.resize(numPoints);
+	m_z.resize(numPoints);
+	m_indices.swap(order);
+
+#pragma omp parallel for
+	for(int i = 0; i < numPoints; ++i)
+	{
+		const size_t pointOffset = 3*m_indices[i];
+		m_x[i] = static_cast<Scalar>(points[pointOffset+0]);
+		m_y[i] = static_cast<Scalar>(points[pointOffset+1]);
+		m_z[i] = static_cast<Scalar>(points[pointOffset+2]);
+	}
+}
+
+template<typename Scalar>
+FlatKDTree3<Scalar>::~FlatKDTree3()
+{
+
+}
+
+template<typename Scalar>
+bool FlatKDTree3<Scalar>::getNearestPoint(const double* point, int& pointIndex, double& sqrDist) const
+{
+	const size_t numPoints = m_indices.size();
+	if(point == NULL || numPoints == 0)
+	{
+		return false;
+	}
+
+	const Scalar qx = static_cast<Scalar>(point[0]);
+	const Scalar qy = static_cast<Scalar>(point[1]);
+	const Scalar qz = static_cast<Scalar>(point[2]);
+
+	double bestSqrDist = DBL_MAX;
+	int bestIndex = -1;
+
+	StackEntry stack[MAX_STACK_SIZE];
+	size_t stackSize(0);
+
+	const StackEntry root = {0, 0, numPoints, 0.0};
+	stack[stackSize++] = root;
+
+	while(stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if(entry.minSqrDist >= bestSqrDist)
+		{
+			continue;
+		}
+
+		if(isLeaf(entry.node))
+		{
+			const size_t leafSize = entry.end-entry.begin;
+			const Scalar* x = &m_x[entry.begin];
+			const Scalar* y = &m_y[entry.begin];
+			const Scalar* z = &m_z[entry.begin];
+
+			//Distances of the whole bucket are computed in one vectorizable loop
+			Scalar leafSqrDists[LEAF_SIZE];
+#pragma omp simd
+			for(size_t j = 0; j < leafSize; ++j)
+			{
+				const Scalar dx = x[j]-qx;
+				const Scalar dy = y[j]-qy;
+				const Scalar dz = z[j]-qz;
+				leafSqrDists[j] = dx*dx+dy*dy+dz*dz;
+			}
+
+			for(size_t j = 0; j < leafSize; ++j)
+			{
+				if(leafSqrDists[j] < bestSqrDist)
+				{
+					bestSqrDist = leafSqrDists[j];
+					bestIndex = m_indices[entry.begin+j];
+				}
+			}
+
+			continue;
+		}
+
+		const size_t mid = entry.begin+(entry.end-entry.begin)/2;
+		const double diff = point[m_splitDims[entry.node]]-m_splitValues[entry.node];
+		const double farSqrDist = std::max(entry.minSqrDist, diff*diff);
+
+		const StackEntry left = {2*entry.node+1, entry.begin, mid, diff < 0.0 ? entry.minSqrDist : farSqrDist};
+		const StackEntry right = {2*entry.node+2, mid, entry.end, diff < 0.0 ? farSqrDist : entry.minSqrDist};
+
+		//Push the far child first to visit the near child next
+		if(diff < 0.0)
+		{
+			stack[stackSize++] = right;
+			stack[stackSize++] = left;
+		}
+		else
+		{
+			stack[stackSize++] = left;
+			stack[stackSize++] = right;
+		}
+	}
+
+	pointIndex = bestIndex;
+	sqrDist = bestSqrDist;
+	return bestIndex >= 0;
+}
+
+template<typename Scalar>
+bool FlatKDTree3<Scalar>::getKNearestPoints(const double* point, const size_t k, int* pointIndices, double* sqrDists) const
+{
+	const size_t numPoints = m_indices.size();
+	if(point == NULL || pointIndices == NULL || sqrDists == NULL || k < 1 || numPoints == 0)
+	{
+		return false;
+	}
+
+	for(size_t i = 0; i < k; ++i)
+	{
+		pointIndices[i] = -1;
+		sqrDists[i] = DBL_MAX;
+	}
+
+	const Scalar qx = static_cast<Scalar>(point[0]);
+	const Scalar qy = static_cast<Scalar>(point[1]);
+	const Scalar qz = static_cast<Scalar>(point[2]);
+
+	StackEntry stack[MAX_STACK_SIZE];
+	size_t stackSize(0);
+
+	const StackEntry root = {0, 0, numPoints, 0.0};
+	stack[stackSize++] = root;
+
+	while(stackSize > 0)
+	{
+		const StackEntry entry = stack[--stackSize];
+		if(entry.minSqrDist >= sqrDists[k-1])
+		{
+			continue;
+		}
+
+		if(isLeaf(entry.node))
+		{
+			const size_t leafSize = entry.end-entry.begin;
+			const Scalar* x = &m_x[entry.begin];
+			const Scalar* y = &m_y[entry.begin];
+			const Scalar* z = &m_z[entry.begin];
+
+			Scalar leafSqrDists[LEAF_SIZE];
+#pragma omp simd
+			for(size_t j = 0; j < leafSize; ++j)
+			{
+				const Scalar dx = x[j]-qx;
+				const Scalar dy = y[j]-qy;
+				const Scalar dz = z[j]-qz;
+				leafSqrDists[j] = dx*dx+dy*dy+dz*dz;
+			}
+
+			//Insert into the sorted list of the k best candidates
+			for(size_t j = 0; j < leafSize; ++j)
+			{
+				const double currSqrDist = static_cast<double>(leafSqrDists[j]);
+				if(currSqrDist >= sqrDists[k-1])
+				{
+					continue;
+				}
+
+				size_t pos = k-1;
+				while(pos > 0 && sqrDists[pos-1] > currSqrDist)
+				{
+					sqrDists[pos] = sqrDists[pos-1];
+					pointIndices[pos] = pointIndices[pos-1];
+					--pos;
+				}
+
+				sqrDists[pos] = currSqrDist;
+				pointIndices[pos] = m_indices[entry.begin+j];
+			}
+
+			continue;
+		}
+
+		const size_t mid = entry.begin+(entry.end-entry.begin)/2;
+		const double diff = point[m_splitDims[entry.node]]-m_splitValues[entry.node];
+		const double farSqrDist = std::max(entry.minSqrDist, diff*diff);
+
+		const StackEntry left = {2*entry.node+1, entry.begin, mid, diff < 0.0 ? entry.minSqrDist : farSqrDist};
+		const StackEntry right = {2*entry.node+2, mid, entry.end, diff < 0.0 ? farSqrDist : entry.minSqrDist};
+
+		if(diff < 0.0)
+		{
+			stack[stackSize++] = right;
+			stack[stackSize++] = left;
+		}
+		else
+		{
+			stack[stackSize++] = left;
+			stack[stackSize++] = right;
+		}
+	}
+
+	return true;
+}
+
+template class FlatKDTree3<float>;
+template class FlatKDTree3<double>;
\ No newline at end of file
@@ -0,0 +1,79 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef FLATKDTREE3_H
+#define FLATKDTREE3_H
+
+#include <vector>
+#include <stdlib.h>
+
+//! Balanced kd tree stored as implicit node array.
+//! The children of node i are the nodes 2i+1 and 2i+2, the point range of a node follows from halving the range of its parent.
+//! The points are reordered such that every leaf bucket is a contiguous range of separate x, y and z arrays.
+//! All queries are read-only and can be called concurrently.
+//! The coordinates are stored with the scalar type Scalar, instantiated for float and double. Queries and returned distances are double, 
+//! with float storage the bucket distances are computed in single precision.
+template<typename Scalar>
+class FlatKDTree3
+{
+public:
+	//! Maximum number of points per leaf bucket
+	static const size_t LEAF_SIZE = 16;
+
+	//! Construct kd tree for a set of 3d vertices.
+	//! \param points				3d vertices
+	FlatKDTree3(const std::vector<double>& points);
+
+	~FlatKDTree3();
+
+	size_t getNumPoints() const { return m_indices.size(); }
+
+	//! Get nearest neighbor.
+	//! \param point				pointer to the xyz-coordinates of the point of request
+	//! \param pointIndex		index of nearest neighbor
+	//! \param sqrDist			squared Euclidean distance of the point
+	//! \return true if successful
+	bool getNearestPoint(const double* point, int& pointIndex, double& sqrDist) const;
+
+	//! Get k nearest neighbors, sorted by increasing distance.
+	//! If the tree contains less than k points, the remaining entries are set to index -1.
+	//! \param point				pointer to the xyz-coordinates of the point of request
+	//! \param k					number of requested nearest neighbors
+	//! \param pointIndices		output array of at least k nearest neighbor indices
+	//! \param sqrDists			output array of at least k squared Euclidean distances
+	//! \return true if successful
+	bool getKNearestPoints(const double* point, const size_t k, int* pointIndices, double* sqrDists) const;
+
+private:
+	FlatKDTree3(const FlatKDTree3& kdTree);
+
+	FlatKDTree3& operator=(const FlatKDTree3& kdTree);
+
+	bool isLeaf(const size_t node) const { return node >= m_numInnerNodes; }
+
+	//Number of levels of inner nodes
+	size_t m_depth;
+	size_t m_numInnerNodes;
+
+	//Split dimension and value per inner node
+	std::vector<unsigned char> m_splitDims;
+	std::vector<Scalar> m_splitValues;
+
+	//Reordered point coordinates and original point indices
+	std::vector<Scalar> m_x;
+	std::vector<Scalar> m_y;
+	std::vector<Scalar> m_z;
+	std::vector<int> m_indices;
+};
+
+#endif
\ No newline at end of file
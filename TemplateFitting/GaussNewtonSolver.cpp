@@ -0,0 +1,562 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "GaussNewtonSolver.h"
+
+#include <algorithm>
+#include <float.h>
+#include <iostream>
+
+namespace
+{
+	//Maximum number of vertices of an undissected subgraph
+	const size_t MIN_DISSECTION_SIZE = 64;
+
+	const double math_eps = 1.0e-6;
+
+	//Relative residual of the conjugate gradient solution, the steps only need to be accurate enough to decrease the energy
+	const double CG_TOLERANCE = 1.0e-2;
+
+	//Relative energy decrease of a step below which the minimization stops
+	const double MIN_RELATIVE_DECREASE = 1.0e-2;
+
+	struct CoordinateLess
+	{
+		CoordinateLess(const std::vector<double>& points, const size_t dim)
+		: m_points(points), m_dim(dim)
+		{}
+
+		bool operator()(const int i1, const int i2) const
+		{
+			return m_points[3*i1+m_dim] < m_points[3*i2+m_dim];
+		}
+
+		const std::vector<double>& m_points;
+		const size_t m_dim;
+	};
+}
+
+GaussNewtonSolver::GaussNewtonSolver(const std::vector<double>& templateVertices, const std::vector<int>& templateNeighborOffsets, const std::vector<int>& templateNeighbors)
+: m_numVertices(templateVertices.size()/3)
+, m_neighborOffsets(templateNeighborOffsets)
+, m_neighbors(templateNeighbors)
+, m_regularizationWeight(0.0)
+{
+	computeVertexOrder(templateVertices);
+
+	//Block column q contains the lower ordered neighbors of the vertex at position q followed by the vertex itself
+	std::vector<int> lowerNeighborPositions;
+
+	m_colPtr.resize(m_numVertices+1, 0);
+	m_rowIndices.clear();
+
+	for(size_t q = 0; q < m_numVertices; ++q)
+	{
+		const int vertex = m_orderedVertices[q];
+
+		lowerNeighborPositions.clear();
+		for(int j = m_neighborOffsets[vertex]; j < m_neighborOffsets[vertex+1]; ++j)
+		{
+			const int neighborPosition = m_vertexOrder[m_neighbors[j]];
+			if(neighborPosition < static_cast<int>(q))
+			{
+				lowerNeighborPositions.push_back(neighborPosition);
+			}
+		}
+
+		std::sort(lowerNeighborPositions.begin(), lowerNeighborPositions.end());
+
+		m_colPtr[q] = static_cast<int>(m_rowIndices.size());
+		m_rowIndices.insert(m_rowIndices.end(), lowerNeighborPositions.begin(), lowerNeighborPositions.end());
+		m_rowIndices.push_back(static_cast<int>(q));
+	}
+
+	m_colPtr[m_numVertices] = static_cast<int>(m_rowIndices.size());
+
+	if(!m_preconditioner.analyzePattern(m_numVertices, m_colPtr, m_rowIndices))
+	{
+		std::cout << "GaussNewtonSolver - symbolic factorization failed" << std::endl;
+	}
+}
+
+GaussNewtonSolver::~GaussNewtonSolver()
+{
+
+}
+
+bool GaussNewtonSolver::minimize(const std::vector<double>& templateVertices, vnl_cost_function& costFunction, const std::vector<char>& validTargetVertices
+											, const double nearestNeighborWeight, const double regularizationWeight, const double rigidWeight, vnl_vector<double>& x)
+{
+	const size_t dim = 12*m_numVertices;
+	if(x.size() != dim || validTargetVertices.size() != m_numVertices || templateVertices.size() != 3*m_numVertices)
+	{
+		std::cout << "GaussNewtonSolver::minimize(...) - wrong dimensions" << std::endl;
+		return false;
+	}
+
+	double f(0.0);
+	vnl_vector<double> g(dim, 0.0);
+	costFunction.compute(x, &f, &g);
+
+	double newF(0.0);
+	vnl_vector<double> newX(dim, 0.0);
+	vnl_vector<double> newG(dim, 0.0);
+
+	std::vector<double> rhs(dim, 0.0);
+	std::vector<double> step(dim, 0.0);
+
+	const double startF = f;
+
+	//Damping relative to the scale of the undamped system
+	assembleSystem(templateVertices, x, validTargetVertices, nearestNeighborWeight, regularizationWeight, rigidWeight, 0.0);
+
+	double maxDiag(0.0);
+	for(size_t i = 0; i < m_numVertices; ++i)
+	{
+		for(size_t p = 0; p < 12; ++p)
+		{
+			maxDiag = std::max(maxDiag, m_blocks[144*i+13*p]);
+		}
+	}
+
+	const double minLambda = std::max(1.0e-9*maxDiag, DBL_MIN);
+	const double maxLambda = 1.0e+9*std::max(maxDiag, 1.0);
+	double lambda = std::max(1.0e-4*maxDiag, minLambda);
+
+	//The preconditioner only depends on the correspondences and weights up to the rigid term and the damping, 
+	//it is factorized once and kept for all steps
+	assembleSystem(templateVertices, x, validTargetVertices, nearestNeighborWeight, regularizationWeight, rigidWeight, lambda);
+	if(!factorizePreconditioner())
+	{
+		std::cout << "GaussNewtonSolver::minimize(...) - preconditioner not positive definite" << std::endl;
+		return false;
+	}
+
+	for(size_t numSteps = 0; numSteps < MAX_NUM_STEPS && lambda < maxLambda; ++numSteps)
+	{
+		if(numSteps > 0)
+		{
+			assembleSystem(templateVertices, x, validTargetVertices, nearestNeighborWeight, regularizationWeight, rigidWeight, lambda);
+		}
+
+		//The gradient of the energy is 2*J^T*r, solve (J^T*J+lambda*I)*step = -J^T*r
+#pragma omp parallel for
+		for(int i = 0; i < dim; ++i)
+		{
+			rhs[i] = -0.5*g[i];
+		}
+
+		solveSystem(rhs, step);
+
+#pragma omp parallel for
+		for(int i = 0; i < dim; ++i)
+		{
+			newX[i] = x[i]+step[i];
+		}
+
+		costFunction.compute(newX, &newF, &newG);
+		if(newF < f)
+		{
+			const double decrease = f-newF;
+
+			x.swap(newX);
+			g.swap(newG);
+			f = newF;
+
+			lambda = std::max(lambda/10.0, minLambda);
+
+			if(decrease < MIN_RELATIVE_DECREASE*f)
+			{
+				break;
+			}
+		}
+		else
+		{
+			lambda *= 10.0;
+		}
+	}
+
+	return f < startF;
+}
+
+void GaussNewtonSolver::computeVertexOrder(const std::vector<double>& templateVertices)
+{
+	m_orderedVertices.clear();
+	m_orderedVertices.reserve(m_numVertices);
+
+	std::vector<int> vertices(m_numVertices);
+	for(size_t i = 0; i < m_numVertices; ++i)
+	{
+		vertices[i] = static_cast<int>(i);
+	}
+
+	std::vector<int> stamps(m_numVertices, 0);
+	int currStamp(0);
+	dissect(templateVertices, vertices, stamps, currStamp);
+
+	m_vertexOrder.resize(m_numVertices, 0);
+	for(size_t q = 0; q < m_numVertices; ++q)
+	{
+		m_vertexOrder[m_orderedVertices[q]] = static_cast<int>(q);
+	}
+}
+
+void GaussNewtonSolver::dissect(const std::vector<double>& templateVertices, std::vector<int>& vertices, std::vector<int>& stamps, int& currStamp)
+{
+	const size_t numVertices = vertices.size();
+	if(numVertices <= MIN_DISSECTION_SIZE)
+	{
+		m_orderedVertices.insert(m_orderedVertices.end(), vertices.begin(), vertices.end());
+		return;
+	}
+
+	//Split at the median of the dimension of largest extent
+	double minValues[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+	double maxValues[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+	for(size_t i = 0; i < numVertices; ++i)
+	{
+		for(size_t d = 0; d < 3; ++d)
+		{
+			const double value = templateVertices[3*vertices[i]+d];
+			minValues[d] = std::min(minValues[d], value);
+			maxValues[d] = std::max(maxValues[d], value);
+		}
+	}
+
+	size_t splitDim(0);
+	for(size_t d = 1; d < 3; ++d)
+	{
+		splitDim = maxValues[d]-minValues[d] > maxValues[splitDim]-minValues[splitDim] ? d : splitDim;
+	}
+
+	const size_t mid = numVertices/2;
+	std::nth_element(vertices.begin(), vertices.begin()+mid, vertices.end(), CoordinateLess(templateVertices, splitDim));
+
+	++currStamp;
+
+	std::vector<int> right(vertices.begin()+mid, vertices.end());
+	for(size_t i = 0; i < right.size(); ++i)
+	{
+		stamps[right[i]] = currStamp;
+	}
+
+	//Vertices of the left half adjacent to the right half separate both halves
+	std::vector<int> left;
+	std::vector<int> separator;
+	left.reserve(mid);
+
+	for(size_t i = 0; i < mid; ++i)
+	{
+		const int vertex = vertices[i];
+
+		bool bSeparator(false);
+		for(int j = m_neighborOffsets[vertex]; j < m_neighborOffsets[vertex+1] && !bSeparator; ++j)
+		{
+			bSeparator = stamps[m_neighbors[j]] == currStamp;
+		}
+
+		if(bSeparator)
+		{
+			separator.push_back(vertex);
+		}
+		else
+		{
+			left.push_back(vertex);
+		}
+	}
+
+	std::vector<int>().swap(vertices);
+
+	dissect(templateVertices, left, stamps, currStamp);
+	dissect(templateVertices, right, stamps, currStamp);
+
+	//Separators are eliminated last
+	m_orderedVertices.insert(m_orderedVertices.end(), separator.begin(), separator.end());
+}
+
+void GaussNewtonSolver::assembleSystem(const std::vector<double>& templateVertices, const vnl_vector<double>& x, const std::vector<char>& validTargetVertices
+													, const double nearestNeighborWeight, const double regularizationWeight, const double rigidWeight, const double lambda)
+{
+	const bool bNearestNeighbor = nearestNeighborWeight >= math_eps;
+	const bool bRigid = rigidWeight >= math_eps;
+
+	m_regularizationWeight = regularizationWeight >= math_eps ? regularizationWeight : 0.0;
+
+	m_blocks.resize(144*m_numVertices);
+
+#pragma omp parallel for
+	for(int i = 0; i < m_numVertices; ++i)
+	{
+		const size_t vertexOffset = 3*i;
+
+		double* H = &m_blocks[144*i];
+		for(size_t j = 0; j < 144; ++j)
+		{
+			H[j] = 0.0;
+		}
+
+		//Residual k depends on the parameters 3m+k with coefficient v_m and on the translation 9+k with coefficient 1
+		if(bNearestNeighbor && validTargetVertices[i])
+		{
+			const double u[4] = {templateVertices[vertexOffset+0], templateVertices[vertexOffset+1], templateVertices[vertexOffset+2], 1.0};
+			for(size_t k = 0; k < 3; ++k)
+			{
+				for(size_t m1 = 0; m1 < 4; ++m1)
+				{
+					for(size_t m2 = 0; m2 < 4; ++m2)
+					{
+						H[12*(3*m1+k)+3*m2+k] += nearestNeighborWeight*u[m1]*u[m2];
+					}
+				}
+			}
+		}
+
+		//Residuals c1*c2, c1*c3, c2*c3, 1-|c1|^2, 1-|c2|^2, 1-|c3|^2 of the columns of the linear part
+		if(bRigid)
+		{
+			double c1[3];
+			double c2[3];
+			double c3[3];
+			for(size_t d = 0; d < 3; ++d)
+			{
+				c1[d] = x[(0+d)*m_numVertices+i];
+				c2[d] = x[(3+d)*m_numVertices+i];
+				c3[d] = x[(6+d)*m_numVertices+i];
+			}
+
+			double J[6][9];
+			for(size_t j = 0; j < 6; ++j)
+			{
+				for(size_t k = 0; k < 9; ++k)
+				{
+					J[j][k] = 0.0;
+				}
+			}
+
+			for(size_t d = 0; d < 3; ++d)
+			{
+				J[0][0+d] = c2[d];
+				J[0][3+d] = c1[d];
+
+				J[1][0+d] = c3[d];
+				J[1][6+d] = c1[d];
+
+				J[2][3+d] = c3[d];
+				J[2][6+d] = c2[d];
+
+				J[3][0+d] = -2.0*c1[d];
+				J[4][3+d] = -2.0*c2[d];
+				J[5][6+d] = -2.0*c3[d];
+			}
+
+			for(size_t j = 0; j < 9; ++j)
+			{
+				for(size_t k = 0; k < 9; ++k)
+				{
+					double sum(0.0);
+					for(size_t r = 0; r < 6; ++r)
+					{
+						sum += J[r][j]*J[r][k];
+					}
+
+					H[12*j+k] += rigidWeight*sum;
+				}
+			}
+		}
+
+		const double diagValue = m_regularizationWeight*(m_neighborOffsets[i+1]-m_neighborOffsets[i]) + lambda;
+		for(size_t p = 0; p < 12; ++p)
+		{
+			H[13*p] += diagValue;
+		}
+	}
+}
+
+bool GaussNewtonSolver::factorizePreconditioner()
+{
+	m_values.resize(16*m_rowIndices.size());
+
+	//Within-row part of the vertex blocks, averaged over the three rows of the affine transformation
+#pragma omp parallel for
+	for(int q = 0; q < m_numVertices; ++q)
+	{
+		const double* H = &m_blocks[144*m_orderedVertices[q]];
+
+		const int diagonalBlock = m_colPtr[q+1]-1;
+		for(int p = m_colPtr[q]; p < diagonalBlock; ++p)
+		{
+			double* values = &m_values[16*p];
+			for(int j = 0; j < 16; ++j)
+			{
+				values[j] = j%5 == 0 ? -m_regularizationWeight : 0.0;
+			}
+		}
+
+		double* values = &m_values[16*diagonalBlock];
+		for(int m1 = 0; m1 < 4; ++m1)
+		{
+			for(int m2 = 0; m2 < 4; ++m2)
+			{
+				double sum(0.0);
+				for(int k = 0; k < 3; ++k)
+				{
+					sum += H[12*(3*m1+k)+3*m2+k];
+				}
+
+				values[4*m1+m2] = sum/3.0;
+			}
+		}
+	}
+
+	return m_preconditioner.factorize(m_values);
+}
+
+void GaussNewtonSolver::solveSystem(const std::vector<double>& b, std::vector<double>& x)
+{
+	const size_t dim = 12*m_numVertices;
+	m_residual.assign(b.begin(), b.end());
+	m_direction.resize(dim);
+	m_preconditioned.resize(dim);
+	m_product.resize(dim);
+
+	x.assign(dim, 0.0);
+
+	double bNorm(0.0);
+	for(size_t i = 0; i < dim; ++i)
+	{
+		bNorm += b[i]*b[i];
+	}
+
+	const double maxResidual = CG_TOLERANCE*CG_TOLERANCE*bNorm;
+
+	precondition(m_residual, m_preconditioned);
+	m_direction = m_preconditioned;
+
+	double rz(0.0);
+	for(size_t i = 0; i < dim; ++i)
+	{
+		rz += m_residual[i]*m_preconditioned[i];
+	}
+
+	for(size_t iter = 0; iter < MAX_NUM_CG_ITER; ++iter)
+	{
+		multiply(m_direction, m_product);
+
+		double dHd(0.0);
+		for(size_t i = 0; i < dim; ++i)
+		{
+			dHd += m_direction[i]*m_product[i];
+		}
+
+		if(dHd <= 0.0)
+		{
+			break;
+		}
+
+		const double alpha = rz/dHd;
+
+		double rr(0.0);
+		for(size_t i = 0; i < dim; ++i)
+		{
+			x[i] += alpha*m_direction[i];
+			m_residual[i] -= alpha*m_product[i];
+			rr += m_residual[i]*m_residual[i];
+		}
+
+		if(rr <= maxResidual)
+		{
+			break;
+		}
+
+		precondition(m_residual, m_preconditioned);
+
+		double newRz(0.0);
+		for(size_t i = 0; i < dim; ++i)
+		{
+			newRz += m_residual[i]*m_preconditioned[i];
+		}
+
+		const double beta = newRz/rz;
+		rz = newRz;
+
+		for(size_t i = 0; i < dim; ++i)
+		{
+			m_direction[i] = m_preconditioned[i]+beta*m_direction[i];
+		}
+	}
+}
+
+void GaussNewtonSolver::multiply(const std::vector<double>& x, std::vector<double>& y) const
+{
+#pragma omp parallel for
+	for(int i = 0; i < m_numVertices; ++i)
+	{
+		const double* H = &m_blocks[144*i];
+
+		double xi[12];
+		for(size_t k = 0; k < 12; ++k)
+		{
+			xi[k] = x[k*m_numVertices+i];
+		}
+
+		for(size_t j = 0; j < 12; ++j)
+		{
+			double sum(0.0);
+			for(size_t k = 0; k < 12; ++k)
+			{
+				sum += H[12*j+k]*xi[k];
+			}
+
+			for(int k = m_neighborOffsets[i]; k < m_neighborOffsets[i+1]; ++k)
+			{
+				sum -= m_regularizationWeight*x[j*m_numVertices+m_neighbors[k]];
+			}
+
+			y[j*m_numVertices+i] = sum;
+		}
+	}
+}
+
+void GaussNewtonSolver::precondition(const std::vector<double>& x, std::vector<double>& y)
+{
+	//Variable m of row k is the parameter 3m+k (m < 3) or the translation 9+k (m = 3), the three rows are solved at once
+	m_preconditionerValues.resize(12*m_numVertices);
+
+#pragma omp parallel for
+	for(int q = 0; q < m_numVertices; ++q)
+	{
+		const int vertex = m_orderedVertices[q];
+		for(size_t m = 0; m < 4; ++m)
+		{
+			for(size_t k = 0; k < 3; ++k)
+			{
+				m_preconditionerValues[12*q+3*m+k] = x[(3*m+k)*m_numVertices+vertex];
+			}
+		}
+	}
+
+	m_preconditioner.solve(m_preconditionerValues, 3);
+
+#pragma omp parallel for
+	for(int q = 0; q < m_numVertices; ++q)
+	{
+		const int vertex = m_orderedVertices[q];
+		for(size_t m = 0; m < 4; ++m)
+		{
+			for(size_t k = 0; k < 3; ++k)
+			{
+				y[(3*m+k)*m_numVertices+vertex] = m_preconditionerValues[12*q+3*m+k];
+			}
+		}
+	}
+}
\ No newline at end of file
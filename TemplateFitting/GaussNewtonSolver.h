@@ -0,0 +1,114 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef GAUSSNEWTONSOLVER_H
+#define GAUSSNEWTONSOLVER_H
+
+#include "SparseBlockCholesky.h"
+
+#include <vnl/vnl_vector.h>
+#include <vnl/vnl_cost_function.h>
+
+#include <vector>
+
+//! Damped Gauss-Newton (Levenberg-Marquardt) minimization of the template fitting energy for fixed correspondences.
+//! The Gauss-Newton system consists of a dense 12x12 block per vertex (nearest neighbor and rigid term) and the edge Laplacian 
+//! of the regularization term, which couples the same parameter of neighboring vertices.
+//! Without the rigid term, the system decouples into three identical systems of dimension 4N, one per row of the affine transformations.
+//! The full system is solved by conjugate gradients, preconditioned by a sparse Cholesky factorization of this 4N system with a 4x4 block per vertex.
+//! Fill reducing ordering and symbolic factorization only depend on the template topology and are computed on construction.
+//! TemplateData constructs one solver per template level, which is shared by all targets fitted with the template. 
+//! A solver is not thread safe, each fitting works on its own copy, which only adds the numeric factorization.
+class GaussNewtonSolver
+{
+public:
+	//! \param templateVertices		3d template vertices, only used for the fill reducing ordering
+	//! \param templateNeighborOffsets	start of the neighbors of each template vertex within templateNeighbors, numVertices+1 values
+	//! \param templateNeighbors			neighbors of all template vertices
+	GaussNewtonSolver(const std::vector<double>& templateVertices, const std::vector<int>& templateNeighborOffsets, const std::vector<int>& templateNeighbors);
+
+	~GaussNewtonSolver();
+
+	//! Minimize the energy for the given correspondences. Correspondences and weights must match those of the cost function.
+	//! \param templateVertices		3d template vertices of the cost function, which may be aligned differently than the vertices of the construction
+	//! \param costFunction				energy and gradient of the current iteration, a TemplateFittingCostFunction of either precision
+	//! \param validTargetVertices		validity per correspondence
+	//! \param nearestNeighborWeight	weight of the nearest neighbor energy
+	//! \param regularizationWeight	weight of the regularization energy
+	//! \param rigidWeight				weight of the rigid energy
+	//! \param x							start value in the parameter layout of TemplateFittingCostFunction, returns the minimizer
+	//! \return true if the energy was reduced
+	bool minimize(const std::vector<double>& templateVertices, vnl_cost_function& costFunction, const std::vector<char>& validTargetVertices
+					, const double nearestNeighborWeight, const double regularizationWeight, const double rigidWeight, vnl_vector<double>& x);
+
+	//! Maximum number of Gauss-Newton steps per minimization
+	static const size_t MAX_NUM_STEPS = 20;
+
+	//! Maximum number of conjugate gradient iterations per Gauss-Newton step
+	static const size_t MAX_NUM_CG_ITER = 5;
+
+private:
+	//! Fill reducing vertex order by geometric nested dissection of the template graph
+	void computeVertexOrder(const std::vector<double>& templateVertices);
+
+	void dissect(const std::vector<double>& templateVertices, std::vector<int>& vertices, std::vector<int>& stamps, int& currStamp);
+
+	//! Compute the vertex blocks of the Gauss-Newton system
+	void assembleSystem(const std::vector<double>& templateVertices, const vnl_vector<double>& x, const std::vector<char>& validTargetVertices
+							, const double nearestNeighborWeight, const double regularizationWeight, const double rigidWeight, const double lambda);
+
+	//! Factorize the preconditioner for the current vertex blocks
+	bool factorizePreconditioner();
+
+	//! Solve the Gauss-Newton system by preconditioned conjugate gradients
+	void solveSystem(const std::vector<double>& b, std::vector<double>& x);
+
+	//! y = H*x
+	void multiply(const std::vector<double>& x, std::vector<double>& y) const;
+
+	//! Apply the preconditioner, y = P^-1*x
+	void precondition(const std::vector<double>& x, std::vector<double>& y);
+
+	size_t m_numVertices;
+
+	//Vertex adjacency in compressed row form
+	std::vector<int> m_neighborOffsets;
+	std::vector<int> m_neighbors;
+
+	//Position of each vertex in the elimination order and vertex of each position
+	std::vector<int> m_vertexOrder;
+	std::vector<int> m_orderedVertices;
+
+	//Upper triangular block pattern of the 4N system in elimination order, block q belongs to the vertex at position q
+	std::vector<int> m_colPtr;
+	std::vector<int> m_rowIndices;
+	std::vector<double> m_values;
+
+	double m_regularizationWeight;
+
+	//Dense 12x12 block per vertex, including damping and regularization diagonal
+	std::vector<double> m_blocks;
+
+	SparseBlockCholesky m_preconditioner;
+
+	//Right hand sides of the preconditioner, the three rows of the affine transformations of each variable are consecutive
+	std::vector<double> m_preconditionerValues;
+
+	//Conjugate gradient workspace
+	std::vector<double> m_residual;
+	std::vector<double> m_direction;
+	std::vector<double> m_preconditioned;
+	std::vector<double> m_product;
+};
+
+#endif
\ No newline at end of file
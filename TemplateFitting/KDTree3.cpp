@@ -12,9 +12,45 @@
 /*************************************************************************************************************************/
 
 #include "KDTree3.h"
+#include "FlatKDTree3.h"
 
-KDTree3::KDTree3(const std::vector<double>& points)
+#ifdef USE_ANN
+#include <ANN/ANN.h>
+#endif
+
+KDTree3::QueryContext::QueryContext(const size_t k)
+: m_k(k > 0 ? k : 1)
+{
+	m_nnIdx = new int[m_k];
+	m_sqrDists = new double[m_k];
+}
+
+KDTree3::QueryContext::~QueryContext()
 {
+	delete [] m_nnIdx;
+	delete [] m_sqrDists;
+}
+
+KDTree3::KDTree3(const std::vector<double>& points, const Backend backend)
+: m_backend(backend != BACKEND_ANN || isANNAvailable() ? backend : BACKEND_BUILTIN)
+, m_pFlatKDTree(NULL)
+, m_pFlatKDTreeFloat(NULL)
+, m_pointArray(NULL)
+, m_pKDTree(NULL)
+{
+	if(m_backend == BACKEND_BUILTIN)
+	{
+		m_pFlatKDTree = new FlatKDTree3<double>(points);
+		return;
+	}
+
+	if(m_backend == BACKEND_BUILTIN_FLOAT)
+	{
+		m_pFlatKDTreeFloat = new FlatKDTree3<float>(points);
+		return;
+	}
+
+#ifdef USE_ANN
 	const size_t numPoints = points.size()/3;
 
 	m_pointArray = annAllocPts(static_cast<int>(numPoints),3);
@@ -29,13 +65,31 @@ KDTree3::KDTree3(const std::vector<double>& points)
 	}
 
 	m_pKDTree = new ANNkd_tree(m_pointArray, static_cast<int>(numPoints), 3); 
+#endif
 }
 
 KDTree3::~KDTree3()
 {
-	annDeallocPts(m_pointArray);
+	delete m_pFlatKDTree;
+	delete m_pFlatKDTreeFloat;
+
+#ifdef USE_ANN
+	if(m_pointArray != NULL)
+	{
+		annDeallocPts(m_pointArray);
+	}
 
 	delete m_pKDTree;
+#endif
+}
+
+bool KDTree3::isANNAvailable()
+{
+#ifdef USE_ANN
+	return true;
+#else
+	return false;
+#endif
 }
 
 bool KDTree3::getNearestPoint(const std::vector<double>& point, int& pointIndex, double& sqrDist) const
@@ -45,29 +99,44 @@ bool KDTree3::getNearestPoint(const std::vector<double>& point, int& pointIndex,
 		return false;
 	}
 
-	ANNpoint queryPoint;
-	queryPoint = annAllocPt(3);
+	return getNearestPoint(&point[0], pointIndex, sqrDist);
+}
 
-	queryPoint[0] = point[0];
-	queryPoint[1] = point[1];
-	queryPoint[2] = point[2];
+bool KDTree3::getNearestPoint(const double* point, int& pointIndex, double& sqrDist) const
+{
+	if(point == NULL)
+	{
+		return false;
+	}
 
-	ANNidxArray nnIdx;
-	nnIdx = new ANNidx[1];
-	
-	ANNdistArray sqrDists;
-	sqrDists = new ANNdist[1];
+	if(m_pFlatKDTree != NULL)
+	{
+		return m_pFlatKDTree->getNearestPoint(point, pointIndex, sqrDist);
+	}
 
-	m_pKDTree->annkSearch(queryPoint, 1, nnIdx, sqrDists, 0.0);
+	if(m_pFlatKDTreeFloat != NULL)
+	{
+		return m_pFlatKDTreeFloat->getNearestPoint(point, pointIndex, sqrDist);
+	}
+
+#ifdef USE_ANN
+	ANNidx nnIdx[1];
+	ANNdist sqrDists[1];
+
+	//ANN keeps the state of a search in global variables, concurrent searches must be serialized
+#pragma omp critical(KDTree3Search)
+	{
+		//ANN does not modify the query point
+		m_pKDTree->annkSearch(const_cast<ANNcoord*>(point), 1, nnIdx, sqrDists, 0.0);
+	}
 
 	pointIndex = nnIdx[0];
 	sqrDist = sqrDists[0];
 
-	annDeallocPt(queryPoint);
-	delete [] nnIdx;
-	delete [] sqrDists;
-
 	return true;
+#else
+	return false;
+#endif
 }
 
 bool KDTree3::getKNearestPoints(const std::vector<double>& point, const size_t k, std::vector<int>& pointIndexVec, std::vector<double>& sqrDistVec) const
@@ -77,33 +146,111 @@ bool KDTree3::getKNearestPoints(const std::vector<double>& point, const size_t k
 		return false;
 	}
 
-	ANNpoint queryPoint;
-	queryPoint = annAllocPt(3);
+	QueryContext context(k);
 
-	queryPoint[0] = point[0];
-	queryPoint[1] = point[1];
-	queryPoint[2] = point[2];
+	pointIndexVec.resize(k);
+	sqrDistVec.resize(k);
 
-	ANNidxArray nnIdx;
-	nnIdx = new ANNidx[k];
+	return getKNearestPoints(&point[0], context, &pointIndexVec[0], &sqrDistVec[0]);
+}
 
-	ANNdistArray sqrDists;
-	sqrDists = new ANNdist[k];
+bool KDTree3::getKNearestPoints(const double* point, QueryContext& context, int* pointIndices, double* sqrDists) const
+{
+	if(point == NULL || pointIndices == NULL || sqrDists == NULL)
+	{
+		return false;
+	}
 
-	m_pKDTree->annkSearch(queryPoint, static_cast<int>(k), nnIdx, sqrDists);
+	const size_t k = context.m_k;
 
-	pointIndexVec.reserve(k);
-	sqrDistVec.reserve(k);
+	if(m_pFlatKDTree != NULL)
+	{
+		return m_pFlatKDTree->getKNearestPoints(point, k, pointIndices, sqrDists);
+	}
 
-	for(size_t i = 0; i < k; ++i)
+	if(m_pFlatKDTreeFloat != NULL)
 	{
-		pointIndexVec.push_back(nnIdx[i]);
-		sqrDistVec.push_back(sqrDists[i]);
+		return m_pFlatKDTreeFloat->getKNearestPoints(point, k, pointIndices, sqrDists);
 	}
 
-	annDeallocPt(queryPoint);
-	delete [] nnIdx;
-	delete [] sqrDists;
+#ifdef USE_ANN
+	//ANN keeps the state of a search in global variables, concurrent searches must be serialized
+#pragma omp critical(KDTree3Search)
+	{
+		m_pKDTree->annkSearch(const_cast<ANNcoord*>(point), static_cast<int>(k), context.m_nnIdx, context.m_sqrDists, 0.0);
+	}
+#else
+	return false;
+#endif
+
+	for(size_t i = 0; i < k; ++i)
+	{
+		pointIndices[i] = context.m_nnIdx[i];
+		sqrDists[i] = context.m_sqrDists[i];
+	}
 
 	return true;
+}
+
+bool KDTree3::getNearestPoints(const double* points, const size_t numPoints, int* pointIndices, double* sqrDists) const
+{
+	if(numPoints == 0)
+	{
+		return true;
+	}
+
+	if(points == NULL || pointIndices == NULL || sqrDists == NULL)
+	{
+		return false;
+	}
+
+	int numFailed(0);
+
+#pragma omp parallel for reduction(+:numFailed)
+	for(int i = 0; i < static_cast<int>(numPoints); ++i)
+	{
+		if(!getNearestPoint(points+3*i, pointIndices[i], sqrDists[i]))
+		{
+			++numFailed;
+		}
+	}
+
+	return numFailed == 0;
+}
+
+bool KDTree3::getKNearestPoints(const double* points, const size_t numPoints, const size_t k, int* pointIndices, double* sqrDists) const
+{
+	if(k < 1)
+	{
+		return false;
+	}
+
+	if(numPoints == 0)
+	{
+		return true;
+	}
+
+	if(points == NULL || pointIndices == NULL || sqrDists == NULL)
+	{
+		return false;
+	}
+
+	int numFailed(0);
+
+#pragma omp parallel reduction(+:numFailed)
+	{
+		QueryContext context(k);
+
+#pragma omp for
+		for(int i = 0; i < static_cast<int>(numPoints); ++i)
+		{
+			const size_t resultOffset = k*i;
+			if(!getKNearestPoints(points+3*i, context, pointIndices+resultOffset, sqrDists+resultOffset))
+			{
+				++numFailed;
+			}
+		}
+	}
+
+	return numFailed == 0;
 }
\ No newline at end of file
@@ -14,20 +14,61 @@
 #ifndef KDTREE3_H
 #define KDTREE3_H
 
-#include <ANN\ANN.h>
-
 #include <vector>
+#include <stdlib.h>
+
+template<typename Scalar> class FlatKDTree3;
+class ANNkd_tree;
 
 //! kd tree
+//! Queries are answered either by the built-in FlatKDTree3 with double or float coordinates, or by ANN, if compiled with USE_ANN.
 class KDTree3
 {
 public:
+	enum Backend
+	{
+		BACKEND_BUILTIN,
+		BACKEND_BUILTIN_FLOAT,
+		BACKEND_ANN
+	};
+
+	//! Reusable result buffers of k nearest neighbor queries.
+	//! A context must not be shared between threads, use one context per thread.
+	class QueryContext
+	{
+	public:
+		//! \param k					number of nearest neighbors per query
+		QueryContext(const size_t k = 1);
+
+		~QueryContext();
+
+		size_t getK() const { return m_k; }
+
+	private:
+		friend class KDTree3;
+
+		QueryContext(const QueryContext& context);
+
+		QueryContext& operator=(const QueryContext& context);
+
+		size_t m_k;
+		int* m_nnIdx;
+		double* m_sqrDists;
+	};
+
 	//! Construct kd tree for a set of 3d vertices.
+	//! Falls back to the built-in backend if ANN is requested but not compiled in.
 	//! \param points				3d vertices
-	KDTree3(const std::vector<double>& points);
+	//! \param backend			search backend
+	KDTree3(const std::vector<double>& points, const Backend backend = BACKEND_BUILTIN);
 
 	~KDTree3();
 
+	Backend getBackend() const { return m_backend; }
+
+	//! Returns true if the ANN backend is compiled in
+	static bool isANNAvailable();
+
 	//! Get nearest neighbor.
 	//! \param point				3d point of request
 	//! \param pointIndex		index of nearest neighbor
@@ -35,20 +76,57 @@ public:
 	//! \return true if successful
 	bool getNearestPoint(const std::vector<double>& point, int& pointIndex, double& sqrDist) const;
 
+	//! Get nearest neighbor without any heap allocation. Safe to call from multiple threads, concurrent ANN searches are serialized.
+	//! \param point				pointer to the xyz-coordinates of the point of request
+	//! \param pointIndex		index of nearest neighbor
+	//! \param sqrDist			squared Euclidean distance of the point
+	//! \return true if successful
+	bool getNearestPoint(const double* point, int& pointIndex, double& sqrDist) const;
+
 	//! Get k nearest neighbors.
 	//! \param point				3d point of request
 	//! \param k					number of requested nearest neighbors
-	//! \param pointIndexVec	vector of nearest neighbor indices
-	//! \param sqrDistVec		vector of squared Euclidean distances
+	//! \param pointIndexVec	vector of nearest neighbor indices, resized to k
+	//! \param sqrDistVec		vector of squared Euclidean distances, resized to k
 	//! \return true if successful
 	bool getKNearestPoints(const std::vector<double>& point, const size_t k, std::vector<int>& pointIndexVec, std::vector<double>& sqrDistVec) const;
 
+	//! Get k nearest neighbors using the buffers of a query context, k is given by the context.
+	//! \param point				pointer to the xyz-coordinates of the point of request
+	//! \param context			query context of the calling thread
+	//! \param pointIndices		output array of at least k nearest neighbor indices
+	//! \param sqrDists			output array of at least k squared Euclidean distances
+	//! \return true if successful
+	bool getKNearestPoints(const double* point, QueryContext& context, int* pointIndices, double* sqrDists) const;
+
+	//! Get nearest neighbors of a batch of points, queried in parallel.
+	//! \param points				xyz-coordinates of the points of request, 3*numPoints values
+	//! \param numPoints			number of points of request
+	//! \param pointIndices		output array of numPoints nearest neighbor indices
+	//! \param sqrDists			output array of numPoints squared Euclidean distances
+	//! \return true if successful
+	bool getNearestPoints(const double* points, const size_t numPoints, int* pointIndices, double* sqrDists) const;
+
+	//! Get k nearest neighbors of a batch of points, queried in parallel.
+	//! \param points				xyz-coordinates of the points of request, 3*numPoints values
+	//! \param numPoints			number of points of request
+	//! \param k					number of requested nearest neighbors per point
+	//! \param pointIndices		output array of k*numPoints nearest neighbor indices, k consecutive values per point
+	//! \param sqrDists			output array of k*numPoints squared Euclidean distances, k consecutive values per point
+	//! \return true if successful
+	bool getKNearestPoints(const double* points, const size_t numPoints, const size_t k, int* pointIndices, double* sqrDists) const;
+
 private:
 	KDTree3(const KDTree3& kdTree);
 	
 	KDTree3& operator=(const KDTree3& kdTree);
 
-	ANNpointArray m_pointArray;
+	Backend m_backend;
+
+	FlatKDTree3<double>* m_pFlatKDTree;
+	FlatKDTree3<float>* m_pFlatKDTreeFloat;
+
+	double** m_pointArray;
 	ANNkd_tree* m_pKDTree;
 };
 
@@ -0,0 +1,268 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "LBFGSMinimizer.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace
+{
+	//Sufficient decrease parameter of the line search
+	const double ARMIJO_FACTOR = 1.0e-4;
+
+	//Maximum number of step reductions per line search
+	const size_t MAX_NUM_LINE_SEARCH_STEPS = 20;
+
+	//Convergence tolerances, chosen as those used with vnl_lbfgsb
+	const double FUNCTION_TOLERANCE = 1.0e+7*DBL_EPSILON;
+	const double GRADIENT_TOLERANCE = 1.0e-5;
+
+	double dotProduct(const double* v1, const double* v2, const size_t dim)
+	{
+		double sum(0.0);
+
+#pragma omp parallel for reduction(+:sum)
+		for(int i = 0; i < dim; ++i)
+		{
+			sum += v1[i]*v2[i];
+		}
+
+		return sum;
+	}
+
+	double maxAbsValue(const double* v, const size_t dim)
+	{
+		double maxValue(0.0);
+		for(size_t i = 0; i < dim; ++i)
+		{
+			maxValue = std::max(maxValue, fabs(v[i]));
+		}
+
+		return maxValue;
+	}
+}
+
+LBFGSMinimizer::LBFGSMinimizer(const size_t numParameters)
+: m_numParameters(numParameters)
+, m_firstPair(0)
+, m_numPairs(0)
+, m_numEvaluations(0)
+{
+	m_s.resize(MEMORY_SIZE);
+	m_y.resize(MEMORY_SIZE);
+	m_rho.resize(MEMORY_SIZE, 0.0);
+}
+
+LBFGSMinimizer::~LBFGSMinimizer()
+{
+
+}
+
+bool LBFGSMinimizer::minimize(vnl_cost_function& costFunction, vnl_vector<double>& x)
+{
+	const size_t dim = m_numParameters;
+	m_numEvaluations = 0;
+
+	if(x.size() != dim)
+	{
+		return false;
+	}
+
+	double f(0.0);
+	vnl_vector<double> g(dim, 0.0);
+	costFunction.compute(x, &f, &g);
+	++m_numEvaluations;
+
+	const double startF = f;
+
+	double newF(0.0);
+	vnl_vector<double> newX(dim, 0.0);
+	vnl_vector<double> newG(dim, 0.0);
+
+	std::vector<double> direction(dim, 0.0);
+	std::vector<double> s(dim, 0.0);
+	std::vector<double> y(dim, 0.0);
+
+	while(m_numEvaluations < MAX_NUM_EVALUATIONS && maxAbsValue(g.data_block(), dim) > GRADIENT_TOLERANCE)
+	{
+		computeDirection(g, direction);
+
+		double directionalDerivative = dotProduct(g.data_block(), &direction[0], dim);
+		if(directionalDerivative >= 0.0)
+		{
+			//Outdated curvature information, restart with steepest descent
+			reset();
+			computeDirection(g, direction);
+			directionalDerivative = dotProduct(g.data_block(), &direction[0], dim);
+		}
+
+		//Without curvature information the steepest descent direction is not scaled
+		double stepLength = m_numPairs > 0 ? 1.0 : 1.0/sqrt(-directionalDerivative);
+
+		//Backtracking line search with quadratic interpolation
+		bool bAccepted(false);
+		for(size_t iStep = 0; iStep < MAX_NUM_LINE_SEARCH_STEPS && m_numEvaluations < MAX_NUM_EVALUATIONS; ++iStep)
+		{
+#pragma omp parallel for
+			for(int i = 0; i < dim; ++i)
+			{
+				newX[i] = x[i]+stepLength*direction[i];
+			}
+
+			costFunction.compute(newX, &newF, &newG);
+			++m_numEvaluations;
+
+			if(newF <= f+ARMIJO_FACTOR*stepLength*directionalDerivative)
+			{
+				bAccepted = true;
+				break;
+			}
+
+			const double denominator = 2.0*(newF-f-stepLength*directionalDerivative);
+			const double interpolatedStep = denominator > 0.0 ? -directionalDerivative*stepLength*stepLength/denominator : 0.5*stepLength;
+			stepLength = std::min(std::max(interpolatedStep, 0.1*stepLength), 0.5*stepLength);
+		}
+
+		if(!bAccepted)
+		{
+			//Retry once with steepest descent if the failed direction used curvature information
+			if(m_numPairs == 0)
+			{
+				break;
+			}
+
+			reset();
+			continue;
+		}
+
+#pragma omp parallel for
+		for(int i = 0; i < dim; ++i)
+		{
+			s[i] = newX[i]-x[i];
+			y[i] = newG[i]-g[i];
+		}
+
+		addCurvaturePair(s, y);
+
+		const double decrease = f-newF;
+
+		x.swap(newX);
+		g.swap(newG);
+		f = newF;
+
+		if(decrease <= FUNCTION_TOLERANCE*std::max(std::max(fabs(f), fabs(f+decrease)), 1.0))
+		{
+			break;
+		}
+	}
+
+	return f < startF;
+}
+
+void LBFGSMinimizer::reset()
+{
+	m_firstPair = 0;
+	m_numPairs = 0;
+}
+
+void LBFGSMinimizer::computeDirection(const vnl_vector<double>& gradient, std::vector<double>& direction)
+{
+	const size_t dim = m_numParameters;
+
+#pragma omp parallel for
+	for(int i = 0; i < dim; ++i)
+	{
+		direction[i] = -gradient[i];
+	}
+
+	if(m_numPairs == 0)
+	{
+		return;
+	}
+
+	//Two-loop recursion from the newest to the oldest pair and back
+	double alpha[MEMORY_SIZE];
+	for(size_t k = m_numPairs; k > 0; --k)
+	{
+		const size_t pair = (m_firstPair+k-1)%MEMORY_SIZE;
+		const std::vector<double>& currS = m_s[pair];
+		const std::vector<double>& currY = m_y[pair];
+
+		alpha[k-1] = m_rho[pair]*dotProduct(&currS[0], &direction[0], dim);
+
+		const double currAlpha = alpha[k-1];
+
+#pragma omp parallel for
+		for(int i = 0; i < dim; ++i)
+		{
+			direction[i] -= currAlpha*currY[i];
+		}
+	}
+
+	//Initial Hessian approximation s^T*y/y^T*y of the newest pair
+	const size_t newestPair = (m_firstPair+m_numPairs-1)%MEMORY_SIZE;
+	const double gamma = 1.0/(m_rho[newestPair]*dotProduct(&m_y[newestPair][0], &m_y[newestPair][0], dim));
+
+#pragma omp parallel for
+	for(int i = 0; i < dim; ++i)
+	{
+		direction[i] *= gamma;
+	}
+
+	for(size_t k = 0; k < m_numPairs; ++k)
+	{
+		const size_t pair = (m_firstPair+k)%MEMORY_SIZE;
+		const std::vector<double>& currS = m_s[pair];
+		const std::vector<double>& currY = m_y[pair];
+
+		const double beta = m_rho[pair]*dotProduct(&currY[0], &direction[0], dim);
+		const double currFactor = alpha[k]-beta;
+
+#pragma omp parallel for
+		for(int i = 0; i < dim; ++i)
+		{
+			direction[i] += currFactor*currS[i];
+		}
+	}
+}
+
+void LBFGSMinimizer::addCurvaturePair(const std::vector<double>& s, const std::vector<double>& y)
+{
+	const size_t dim = m_numParameters;
+
+	//Only pairs of positive curvature keep the approximation positive definite
+	const double sy = dotProduct(&s[0], &y[0], dim);
+	const double yy = dotProduct(&y[0], &y[0], dim);
+	if(sy <= DBL_EPSILON*yy || yy <= 0.0)
+	{
+		return;
+	}
+
+	size_t pair(0);
+	if(m_numPairs < MEMORY_SIZE)
+	{
+		pair = (m_firstPair+m_numPairs)%MEMORY_SIZE;
+		++m_numPairs;
+	}
+	else
+	{
+		pair = m_firstPair;
+		m_firstPair = (m_firstPair+1)%MEMORY_SIZE;
+	}
+
+	m_s[pair] = s;
+	m_y[pair] = y;
+	m_rho[pair] = 1.0/sy;
+}
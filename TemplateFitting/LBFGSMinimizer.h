@@ -0,0 +1,71 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef LBFGSMINIMIZER_H
+#define LBFGSMINIMIZER_H
+
+#include <vnl/vnl_vector.h>
+#include <vnl/vnl_cost_function.h>
+
+#include <vector>
+
+//! Unconstrained limited-memory BFGS minimization whose curvature pairs persist between calls of minimize.
+//! Consecutive minimizations of similar energies, like the iterations of the template fitting, start with the curvature information 
+//! of the previous minimization instead of a scaled identity. Call reset to discard the history if the energy changed too much.
+class LBFGSMinimizer
+{
+public:
+	//! \param numParameters		dimension of the parameter vector
+	LBFGSMinimizer(const size_t numParameters);
+
+	~LBFGSMinimizer();
+
+	//! Minimize the cost function starting at x.
+	//! \param costFunction		energy and gradient
+	//! \param x					start value, returns the minimizer
+	//! \return true if the energy was reduced
+	bool minimize(vnl_cost_function& costFunction, vnl_vector<double>& x);
+
+	//! Discard all stored curvature pairs
+	void reset();
+
+	size_t getNumCurvaturePairs() const { return m_numPairs; }
+
+	//! Number of energy evaluations of the last minimization
+	size_t getNumEvaluations() const { return m_numEvaluations; }
+
+	//! Number of stored curvature pairs
+	static const size_t MEMORY_SIZE = 10;
+
+	//! Maximum number of energy evaluations per minimization
+	static const size_t MAX_NUM_EVALUATIONS = 100;
+
+private:
+	//! Two-loop recursion, direction = -H*gradient
+	void computeDirection(const vnl_vector<double>& gradient, std::vector<double>& direction);
+
+	void addCurvaturePair(const std::vector<double>& s, const std::vector<double>& y);
+
+	size_t m_numParameters;
+
+	//Curvature pairs in a ring buffer, m_firstPair is the oldest
+	std::vector<std::vector<double>> m_s;
+	std::vector<std::vector<double>> m_y;
+	std::vector<double> m_rho;
+	size_t m_firstPair;
+	size_t m_numPairs;
+
+	size_t m_numEvaluations;
+};
+
+#endif
\ No newline at end of file
@@ -13,14 +13,139 @@
 
 #include <string>
 #include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <functional>
 
 #include "DataContainer.h"
 #include "FileLoader.h"
 #include "FileWriter.h"
+#include "FitOptions.h"
+#include "TargetData.h"
+#include "TemplateData.h"
 #include "TemplateFitting.h"
 #include "MathHelper.h"
+#include "Definitions.h"
+#include "Timer.h"
 
-int computeTempateFitting(const std::string& sstrTemplateFile, const std::string& sstrTargetFile, const std::string& sstrOutFile)
+//Appends the suffix to the file name, the extension is replaced if sstrExtension is not empty
+std::string getSweepFileName(const std::string& sstrOutFile, const std::string& sstrSuffix, const std::string& sstrExtension = "")
+{
+	const size_t pathPos = sstrOutFile.find_last_of("/\\");
+	size_t extensionPos = sstrOutFile.rfind(".");
+	if(extensionPos == std::string::npos || (pathPos != std::string::npos && extensionPos < pathPos))
+	{
+		extensionPos = sstrOutFile.size();
+	}
+
+	const std::string sstrOutExtension = sstrExtension.empty() ? sstrOutFile.substr(extensionPos) : sstrExtension;
+	return sstrOutFile.substr(0, extensionPos) + "_" + sstrSuffix + sstrOutExtension;
+}
+
+//Output file of option set i of a parameter sweep
+std::string getSweepFileName(const std::string& sstrOutFile, const int i)
+{
+	std::stringstream stream;
+	stream << i;
+	return getSweepFileName(sstrOutFile, stream.str());
+}
+
+int computeParameterSweep(const TemplateData& templateData, const std::vector<double>& templateVertices, const DataContainer& targetMesh, const std::string& sstrOutFile, const std::vector<FitOptions>& optionSets)
+{
+	const int numOptionSets = static_cast<int>(optionSets.size());
+	std::cout << "Parameter sweep over " << numOptionSets << " option sets" << std::endl;
+
+	//Target normals and search structures are computed once per precision and shared by all fittings
+	TargetData* targetData[2] = {NULL, NULL};
+	for(int i = 0; i < numOptionSets; ++i)
+	{
+		const Precision precision = optionSets[i].precision;
+		if(targetData[precision] == NULL)
+		{
+			targetData[precision] = new TargetData(targetMesh, precision);
+		}
+	}
+
+	std::vector<TemplateFitting::FitStatistics> statistics(numOptionSets);
+	std::vector<char> savedValues(numOptionSets, 0);
+
+	//Each option set is fitted by a single thread, the parallel loops within a fitting are not nested
+#pragma omp parallel for schedule(dynamic)
+	for(int i = 0; i < numOptionSets; ++i)
+	{
+		FitOptions options(optionSets[i]);
+		options.bVerbose = false;
+
+		DataContainer outMesh;
+		TemplateFitting::fitTemplate(templateData, templateVertices, *targetData[options.precision], options, outMesh, &statistics[i]);
+
+		savedValues[i] = FileWriter::saveFile(getSweepFileName(sstrOutFile, i), outMesh) ? 1 : 0;
+	}
+
+	delete targetData[PRECISION_DOUBLE];
+	delete targetData[PRECISION_FLOAT];
+
+	//Summary table with one line per option set
+	std::stringstream summary;
+	summary << "#index iterations converged validFraction meanDistance time[ms] parameters" << std::endl;
+	for(int i = 0; i < numOptionSets; ++i)
+	{
+		const TemplateFitting::FitStatistics& currStatistics = statistics[i];
+		summary << i << " " << currStatistics.numIterations << " " << (currStatistics.bConverged ? 1 : 0) << " " << currStatistics.validFraction 
+			<< " " << currStatistics.meanDistance << " " << currStatistics.time << " " << optionSets[i].toString() << std::endl;
+	}
+
+	std::cout << summary.str();
+
+	const std::string sstrSummaryFile = getSweepFileName(sstrOutFile, "sweep", ".txt");
+	std::ofstream summaryFile(sstrSummaryFile.c_str());
+	if(!summaryFile.is_open() || !(summaryFile << summary.str()))
+	{
+		std::cout << "Unable to save file " << sstrSummaryFile << std::endl;
+		return 1;
+	}
+
+	for(int i = 0; i < numOptionSets; ++i)
+	{
+		if(!savedValues[i])
+		{
+			std::cout << "Unable to save file " << getSweepFileName(sstrOutFile, i) << std::endl;
+			return 1;
+		}
+	}
+
+	std::cout << "Successfull " << sstrSummaryFile << std::endl;
+	return 0;
+}
+
+//Fits the template data with the given template vertices to the target, a single fitting or a parameter sweep over several option sets
+int computeFitting(const TemplateData& templateData, const std::vector<double>& templateVertices, const DataContainer& targetMesh, const std::string& sstrOutFile, const std::vector<FitOptions>& optionSets)
+{
+	if(optionSets.size() > 1)
+	{
+		return computeParameterSweep(templateData, templateVertices, targetMesh, sstrOutFile, optionSets);
+	}
+
+	const TargetData targetData(targetMesh, optionSets[0].precision);
+
+	DataContainer outMesh;
+	TemplateFitting::fitTemplate(templateData, templateVertices, targetData, optionSets[0], outMesh);
+	
+	if(!FileWriter::saveFile(sstrOutFile, outMesh))
+	{
+		std::cout << "Unable to save file " << sstrOutFile << std::endl;
+		return 1;
+	}
+	else
+	{
+		std::cout << "Successfull " << sstrOutFile << std::endl;
+	}
+
+	return 0;
+}
+
+int computeTempateFitting(const std::string& sstrTemplateFile, const std::string& sstrTargetFile, const std::string& sstrOutFile, const std::vector<FitOptions>& optionSets)
 {
 	if(!FileLoader::fileExist(sstrTemplateFile))
 	{
@@ -35,13 +160,6 @@ int computeTempateFitting(const std::string& sstrTemplateFile, const std::string
 	}
 
 	FileLoader loader;
-	
-	DataContainer templateMesh;
-	if(!loader.loadFile(sstrTemplateFile, templateMesh))
-	{
-		std::cout << "Unable to load template file " << sstrTemplateFile << std::endl;
-		return 1;
-	}
 
 	DataContainer targetMesh;
 	if(!loader.loadFile(sstrTargetFile, targetMesh))
@@ -50,20 +168,21 @@ int computeTempateFitting(const std::string& sstrTemplateFile, const std::string
 		return 1;
 	}
 
-	DataContainer outMesh;
-	TemplateFitting::fitTemplate(templateMesh, targetMesh, outMesh);
-	
-
-	if(!FileWriter::saveFile(sstrOutFile, outMesh))
+	//Cleaned template and its fitting data, read from the template cache if available
+	TemplateData* pTemplateData = TemplateData::load(sstrTemplateFile);
+	if(pTemplateData == NULL)
 	{
-		std::cout << "Unable to save file " << sstrOutFile << std::endl;
+		std::cout << "Unable to load template file " << sstrTemplateFile << std::endl;
 		return 1;
 	}
 
-	return 0;
+	const int result = computeFitting(*pTemplateData, pTemplateData->getMesh().getVertexList(), targetMesh, sstrOutFile, optionSets);
+	delete pTemplateData;
+
+	return result;
 }
 
-int computeAlignedTempateFitting(const std::string& sstrTemplateFile, const std::string& sstrTemplateLmkFile, const std::string& sstrTargetFile, const std::string& sstrTargetLmkFile, const std::string& sstrOutFile)
+int computeAlignedTempateFitting(const std::string& sstrTemplateFile, const std::string& sstrTemplateLmkFile, const std::string& sstrTargetFile, const std::string& sstrTargetLmkFile, const std::string& sstrOutFile, const std::vector<FitOptions>& optionSets)
 {
 	if(!FileLoader::fileExist(sstrTemplateFile))
 	{
@@ -90,13 +209,6 @@ int computeAlignedTempateFitting(const std::string& sstrTemplateFile, const std:
 	}
 
 	FileLoader loader;
-	
-	DataContainer templateMesh;
-	if(!loader.loadFile(sstrTemplateFile, templateMesh))
-	{
-		std::cout << "Unable to load template file " << sstrTemplateFile << std::endl;
-		return 1;
-	}
 
 	std::vector<double> templateLmks;
 	if(!loader.loadDataFile(sstrTemplateLmkFile, templateLmks))
@@ -119,6 +231,14 @@ int computeAlignedTempateFitting(const std::string& sstrTemplateFile, const std:
 		return 1;
 	}
 
+	//Cleaned template and its fitting data, read from the template cache if available
+	TemplateData* pTemplateData = TemplateData::load(sstrTemplateFile);
+	if(pTemplateData == NULL)
+	{
+		std::cout << "Unable to load template file " << sstrTemplateFile << std::endl;
+		return 1;
+	}
+
 	//Compute rigid landmark alignment
 	double s(1.0);
 	std::vector<double> R;
@@ -128,47 +248,378 @@ int computeAlignedTempateFitting(const std::string& sstrTemplateFile, const std:
 		std::cout << "Unable to compute rigid landmark alignment" << std::endl;
 	}
 
-	//Transform template mesh
-	MathHelper::transformMesh(s, R, "N", t, "+", templateMesh);
+	//Transform template vertices
+	std::vector<double> templateVertices = pTemplateData->getMesh().getVertexList();
+	MathHelper::transformData(s, R, "N", t, "+", templateVertices);
+
+	const int result = computeFitting(*pTemplateData, templateVertices, targetMesh, sstrOutFile, optionSets);
+	delete pTemplateData;
+
+	return result;
+}
+
+//Fitting of a batch manifest line
+struct BatchEntry
+{
+	std::string sstrTargetFile;
+	std::string sstrTargetLmkFile;
+	std::string sstrOutFile;
+};
+
+//Loads a batch manifest with one fitting per line, "targetMesh outMesh" or "targetMesh targetLmks outMesh". Empty lines and lines starting with # are skipped.
+bool loadBatchManifest(const std::string& sstrManifestFile, std::vector<BatchEntry>& entries)
+{
+	std::ifstream manifest(sstrManifestFile.c_str());
+	if(!manifest.is_open())
+	{
+		std::cout << "Unable to open batch manifest " << sstrManifestFile << std::endl;
+		return false;
+	}
+
+	entries.clear();
+
+	std::string sstrLine;
+	size_t lineNumber(0);
+	while(std::getline(manifest, sstrLine))
+	{
+		++lineNumber;
+
+		std::vector<std::string> fields;
+		std::stringstream lineStream(sstrLine);
+		std::string sstrField;
+		while(lineStream >> sstrField)
+		{
+			fields.push_back(sstrField);
+		}
+
+		if(fields.empty() || fields[0][0] == '#')
+		{
+			continue;
+		}
+
+		BatchEntry entry;
+		if(fields.size() == 2)
+		{
+			entry.sstrTargetFile = fields[0];
+			entry.sstrOutFile = fields[1];
+		}
+		else if(fields.size() == 3)
+		{
+			entry.sstrTargetFile = fields[0];
+			entry.sstrTargetLmkFile = fields[1];
+			entry.sstrOutFile = fields[2];
+		}
+		else
+		{
+			std::cout << "Wrong number of entries in line " << lineNumber << " of batch manifest " << sstrManifestFile << std::endl;
+			return false;
+		}
+
+		entries.push_back(entry);
+	}
+
+	return true;
+}
+
+//File size in bytes, 0 if the file cannot be opened
+size_t getFileSize(const std::string& sstrFileName)
+{
+	std::ifstream file(sstrFileName.c_str(), std::ios::binary | std::ios::ate);
+	return file.is_open() ? static_cast<size_t>(file.tellg()) : 0;
+}
+
+//Loads the target and its landmarks, aligns the template vertices to the target landmarks, fits the template and saves the result
+//Messages of the entry are written to logStream, such that concurrent entries do not interleave their output
+bool computeBatchEntry(const TemplateData& templateData, const std::vector<double>& templateLmks, const BatchEntry& entry, const FitOptions& options, std::ostream& logStream, TemplateFitting::FitStatistics& statistics)
+{
+	FileLoader loader;
+	loader.setLogStream(logStream);
+
+	DataContainer targetMesh;
+	if(!FileLoader::fileExist(entry.sstrTargetFile) || !loader.loadFile(entry.sstrTargetFile, targetMesh))
+	{
+		logStream << "Unable to load target file " << entry.sstrTargetFile << std::endl;
+		return false;
+	}
+
+	//The template itself is shared, aligned fittings use a transformed copy of its vertices
+	std::vector<double> templateVertices = templateData.getMesh().getVertexList();
+	if(!entry.sstrTargetLmkFile.empty())
+	{
+		std::vector<double> targetLmks;
+		if(!FileLoader::fileExist(entry.sstrTargetLmkFile) || !loader.loadDataFile(entry.sstrTargetLmkFile, targetLmks))
+		{
+			logStream << "Unable to load target landmark file " << entry.sstrTargetLmkFile << std::endl;
+			return false;
+		}
+
+		double s(1.0);
+		std::vector<double> R;
+		std::vector<double> t;
+		if(!MathHelper::computeAlignmentTrafo(templateLmks, targetLmks, s, R, t))
+		{
+			logStream << "Unable to compute rigid landmark alignment " << entry.sstrTargetLmkFile << std::endl;
+		}
+		else
+		{
+			MathHelper::transformData(s, R, "N", t, "+", templateVertices);
+		}
+	}
+
+	const TargetData targetData(targetMesh, options.precision);
 
 	DataContainer outMesh;
-	TemplateFitting::fitTemplate(templateMesh, targetMesh, outMesh);
-	
-	if(!FileWriter::saveFile(sstrOutFile, outMesh))
+	TemplateFitting::fitTemplate(templateData, templateVertices, targetData, options, outMesh, &statistics);
+
+	if(!FileWriter::saveFile(entry.sstrOutFile, outMesh))
 	{
-		std::cout << "Unable to save file " << sstrOutFile << std::endl;
+		logStream << "Unable to save file " << entry.sstrOutFile << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+int computeBatchFitting(const std::string& sstrTemplateFile, const std::string& sstrTemplateLmkFile, const std::string& sstrManifestFile, const std::vector<FitOptions>& optionSets)
+{
+	if(optionSets.size() > 1)
+	{
+		std::cout << "Parameter sweeps are not supported in batch mode" << std::endl;
 		return 1;
 	}
+
+	std::vector<BatchEntry> entries;
+	if(!loadBatchManifest(sstrManifestFile, entries))
+	{
+		return 1;
+	}
+
+	if(!FileLoader::fileExist(sstrTemplateFile))
+	{
+		std::cout << "Template file does not exist " << sstrTemplateFile << std::endl;
+		return 1;
+	}
+
+	FileLoader loader;
+
+	std::vector<double> templateLmks;
+	if(!sstrTemplateLmkFile.empty() && (!FileLoader::fileExist(sstrTemplateLmkFile) || !loader.loadDataFile(sstrTemplateLmkFile, templateLmks)))
+	{
+		std::cout << "Unable to load template landmark file " << sstrTemplateLmkFile << std::endl;
+		return 1;
+	}
+
+	const int numEntries = static_cast<int>(entries.size());
+	for(int i = 0; i < numEntries; ++i)
+	{
+		if(!entries[i].sstrTargetLmkFile.empty() && templateLmks.empty())
+		{
+			std::cout << "Target landmarks " << entries[i].sstrTargetLmkFile << " require a template landmark file" << std::endl;
+			return 1;
+		}
+	}
+
+	//Cleaned template and its fitting data are loaded once and shared by all fittings
+	TemplateData* pTemplateData = TemplateData::load(sstrTemplateFile);
+	if(pTemplateData == NULL)
+	{
+		std::cout << "Unable to load template file " << sstrTemplateFile << std::endl;
+		return 1;
+	}
+
+	//Largest targets first, such that the dynamically scheduled threads do not end with a single long fitting
+	std::vector<std::pair<size_t, int>> entryOrder(numEntries);
+	for(int i = 0; i < numEntries; ++i)
+	{
+		entryOrder[i] = std::make_pair(getFileSize(entries[i].sstrTargetFile), i);
+	}
+
+	std::stable_sort(entryOrder.begin(), entryOrder.end(), std::greater<std::pair<size_t, int>>());
+
+	std::cout << "Batch fitting of " << numEntries << " targets" << std::endl;
+
+	FitOptions options(optionSets[0]);
+	options.bVerbose = false;
+
+	std::vector<char> successValues(numEntries, 0);
+	int numFinished(0);
+
+	Timer batchTimer;
+
+	//Each target is loaded, fitted and saved by a single thread, the parallel loops within a fitting are not nested
+#pragma omp parallel for schedule(dynamic)
+	for(int i = 0; i < numEntries; ++i)
+	{
+		const int entry = entryOrder[i].second;
+
+		std::stringstream entryLog;
+		TemplateFitting::FitStatistics statistics;
+		successValues[entry] = computeBatchEntry(*pTemplateData, templateLmks, entries[entry], options, entryLog, statistics) ? 1 : 0;
+
+#pragma omp critical
+		{
+			std::cout << entryLog.str();
+
+			++numFinished;
+			std::cout << "[" << numFinished << "/" << numEntries << "] " << entries[entry].sstrTargetFile;
+			if(successValues[entry])
+			{
+				std::cout << ": " << statistics.numIterations << " iterations, mean distance " << statistics.meanDistance << ", " << statistics.time << " ms";
+			}
+			else
+			{
+				std::cout << ": failed";
+			}
+			std::cout << std::endl;
+		}
+	}
+
+	const int numSuccessful = static_cast<int>(std::count(successValues.begin(), successValues.end(), 1));
+	std::cout << "Fitted " << numSuccessful << " of " << numEntries << " targets in " << batchTimer.elapsedMilliseconds() << " ms" << std::endl;
+
+	delete pTemplateData;
+
+	return numSuccessful == numEntries ? 0 : 1;
+}
+
+//Loads and cleans a mesh and saves it in the format of the output file extension, binary meshes with float32 vertices if bFloat32 is set
+int convertMesh(const std::string& sstrInFile, const std::string& sstrOutFile, const bool bFloat32)
+{
+	FileLoader loader;
+
+	DataContainer mesh;
+	if(!FileLoader::fileExist(sstrInFile) || !loader.loadFile(sstrInFile, mesh))
+	{
+		std::cout << "Unable to load file " << sstrInFile << std::endl;
+		return 1;
+	}
+
+	const std::string sstrOutSuffix = FileWriter::getFileExtension(sstrOutFile);
+
+	bool bSaved(false);
+	if(sstrOutSuffix == "bmsh")
+	{
+		bSaved = FileWriter::writeBinaryMesh(sstrOutFile, mesh, bFloat32);
+	}
+	else if(sstrOutSuffix == "ply")
+	{
+		bSaved = FileWriter::writeBinaryPly(sstrOutFile, mesh, bFloat32);
+	}
 	else
 	{
-		std::cout << "Successfull " << sstrOutFile << std::endl;
+		bSaved = FileWriter::saveFile(sstrOutFile, mesh);
 	}
 
-	return 0;
+	if(!bSaved)
+	{
+		std::cout << "Unable to save file " << sstrOutFile << std::endl;
+		return 1;
+	}
 
+	std::cout << "Successfull " << sstrOutFile << std::endl;
+	return 0;
 }
 
 int main(int argc, char* argv[])
 {
-	if(argc == 4)
+	//Arguments starting with - are options, all other arguments are file names.
+	//-config <file> loads a parameter file, -<parameter> <value[,value...]> sets a parameter and -float selects single precision.
+	//Parameters with several values span a grid of option sets, which is fitted as parameter sweep.
+	//-batch <manifest> fits the template (and template landmark) file to all targets of the manifest.
+	//-convert <outMesh> converts the single mesh file to the format of outMesh, e.g. to the binary mesh format (.bmsh) or binary PLY (.ply), -float stores float32 vertices.
+	FitOptions::ParameterValues parameterValues;
+	std::vector<std::string> fileNames;
+	std::string sstrManifestFile;
+	std::string sstrConvertFile;
+
+	for(int i = 1; i < argc; ++i)
+	{
+		const std::string sstrArgument(argv[i]);
+		if(sstrArgument == "-float")
+		{
+			FitOptions::addParameter("precision", "float", parameterValues);
+		}
+		else if(sstrArgument.size() > 1 && sstrArgument[0] == '-')
+		{
+			if(i+1 >= argc)
+			{
+				std::cout << "Missing value of option " << sstrArgument << std::endl;
+				return 1;
+			}
+
+			const std::string sstrName = sstrArgument.substr(1);
+			const std::string sstrValue(argv[++i]);
+
+			if(sstrName == "batch")
+			{
+				sstrManifestFile = sstrValue;
+				continue;
+			}
+			else if(sstrName == "convert")
+			{
+				sstrConvertFile = sstrValue;
+				continue;
+			}
+
+			const bool bValid = sstrName == "config" ? FitOptions::loadParameterFile(sstrValue, parameterValues) : FitOptions::addParameter(sstrName, sstrValue, parameterValues);
+			if(!bValid)
+			{
+				return 1;
+			}
+		}
+		else
+		{
+			fileNames.push_back(sstrArgument);
+		}
+	}
+
+	std::vector<FitOptions> optionSets;
+	if(!FitOptions::createOptionSets(parameterValues, optionSets))
+	{
+		return 1;
+	}
+
+	if(!sstrConvertFile.empty())
+	{
+		if(fileNames.size() != 1)
+		{
+			std::cout << "Wrong number of parameters " << fileNames.size()+1 << std::endl;
+			return 1;
+		}
+
+		return convertMesh(fileNames[0], sstrConvertFile, optionSets[0].precision == PRECISION_FLOAT);
+	}
+	else if(!sstrManifestFile.empty())
+	{
+		if(fileNames.empty() || fileNames.size() > 2)
+		{
+			std::cout << "Wrong number of parameters " << fileNames.size()+1 << std::endl;
+			return 1;
+		}
+
+		const std::string sstrTemplateFile(fileNames[0]);
+		const std::string sstrTemplateLmkFile(fileNames.size() == 2 ? fileNames[1] : "");
+		return computeBatchFitting(sstrTemplateFile, sstrTemplateLmkFile, sstrManifestFile, optionSets);
+	}
+	else if(fileNames.size() == 3)
 	{
-		const std::string sstrTemplateFile(argv[1]);
-		const std::string sstrTargetFile(argv[2]);
-		const std::string sstrOutFile(argv[3]);
-		return computeTempateFitting(sstrTemplateFile, sstrTargetFile, sstrOutFile);
+		const std::string sstrTemplateFile(fileNames[0]);
+		const std::string sstrTargetFile(fileNames[1]);
+		const std::string sstrOutFile(fileNames[2]);
+		return computeTempateFitting(sstrTemplateFile, sstrTargetFile, sstrOutFile, optionSets);
 	}
-	else if(argc == 6)
+	else if(fileNames.size() == 5)
 	{
-		const std::string sstrTemplateFile(argv[1]);
-		const std::string sstrTemplateLmkFile(argv[2]);
-		const std::string sstrTargetFile(argv[3]);
-		const std::string sstrTargetLmkFile(argv[4]);
-		const std::string sstrOutFile(argv[5]);
-		return computeAlignedTempateFitting(sstrTemplateFile, sstrTemplateLmkFile, sstrTargetFile, sstrTargetLmkFile, sstrOutFile);
+		const std::string sstrTemplateFile(fileNames[0]);
+		const std::string sstrTemplateLmkFile(fileNames[1]);
+		const std::string sstrTargetFile(fileNames[2]);
+		const std::string sstrTargetLmkFile(fileNames[3]);
+		const std::string sstrOutFile(fileNames[4]);
+		return computeAlignedTempateFitting(sstrTemplateFile, sstrTemplateLmkFile, sstrTargetFile, sstrTargetLmkFile, sstrOutFile, optionSets);
 	}
 	else
 	{
-		std::cout << "Wrong number of parameters " << argc << std::endl;
+		std::cout << "Wrong number of parameters " << fileNames.size()+1 << std::endl;
 		return 1;
 	}
 
@@ -0,0 +1,134 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+: m_pData(NULL)
+, m_size(0)
+#ifdef _WIN32
+, m_hFile(INVALID_HANDLE_VALUE)
+, m_hMapping(NULL)
+#else
+, m_fileDescriptor(-1)
+#endif
+{
+
+}
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+bool MappedFile::open(const std::string& sstrFileName)
+{
+	close();
+
+#ifdef _WIN32
+	m_hFile = CreateFileA(sstrFileName.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(m_hFile == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(m_hFile, &fileSize) || fileSize.QuadPart == 0)
+	{
+		close();
+		return false;
+	}
+
+	m_hMapping = CreateFileMappingA(m_hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(m_hMapping == NULL)
+	{
+		close();
+		return false;
+	}
+
+	m_pData = static_cast<const char*>(MapViewOfFile(m_hMapping, FILE_MAP_READ, 0, 0, 0));
+	m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	m_fileDescriptor = ::open(sstrFileName.c_str(), O_RDONLY);
+	if(m_fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if(fstat(m_fileDescriptor, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		close();
+		return false;
+	}
+
+	void* pData = mmap(NULL, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, m_fileDescriptor, 0);
+	m_pData = pData != MAP_FAILED ? static_cast<const char*>(pData) : NULL;
+	m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	if(m_pData == NULL)
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+	if(m_pData != NULL)
+	{
+		UnmapViewOfFile(m_pData);
+	}
+
+	if(m_hMapping != NULL)
+	{
+		CloseHandle(m_hMapping);
+	}
+
+	if(m_hFile != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_hFile);
+	}
+
+	m_hFile = INVALID_HANDLE_VALUE;
+	m_hMapping = NULL;
+#else
+	if(m_pData != NULL)
+	{
+		munmap(const_cast<char*>(m_pData), m_size);
+	}
+
+	if(m_fileDescriptor >= 0)
+	{
+		::close(m_fileDescriptor);
+	}
+
+	m_fileDescriptor = -1;
+#endif
+
+	m_pData = NULL;
+	m_size = 0;
+}
\ No newline at end of file
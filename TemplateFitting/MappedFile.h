@@ -0,0 +1,52 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <string>
+
+//! Read-only memory mapping of a file, the mapping is released by close or on destruction
+class MappedFile
+{
+public:
+	MappedFile();
+
+	~MappedFile();
+
+	//! Maps the whole file, returns false if the file cannot be opened or is empty
+	bool open(const std::string& sstrFileName);
+
+	void close();
+
+	const char* getData() const { return m_pData; }
+
+	size_t getSize() const { return m_size; }
+
+private:
+	MappedFile(const MappedFile& mappedFile);
+
+	MappedFile& operator=(const MappedFile& mappedFile);
+
+	const char* m_pData;
+	size_t m_size;
+
+#ifdef _WIN32
+	void* m_hFile;
+	void* m_hMapping;
+#else
+	int m_fileDescriptor;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -13,8 +13,8 @@
 
 #include "MathHelper.h"
 
+#include <algorithm>
 #include <vector>
-#include <map>
 #include <iostream>
 #include <sstream>
 
@@ -44,71 +44,80 @@ namespace clapack
 	}
 }
 
-void MathHelper::computeVertexNormals(const DataContainer& poly, std::vector<double>& vertexNormals)
+namespace
 {
-	const std::vector<double>& vertexList = poly.getVertexList();
-	const std::vector<std::vector<int>>& vertexIndexList = poly.getVertexIndexList();
+	//Number of flags processed by one block of the parallel prefix sum
+	const int PREFIX_SUM_BLOCK_SIZE = 1 << 16;
 
-	std::map<int, std::vector<size_t>> polygonsForVertexIndexMap;
+	//Exclusive prefix sum of the flags, computed in parallel blocks. The position of a set flag is the number of set flags before it.
+	//\return number of set flags
+	int computeFlagPositions(const std::vector<char>& flags, std::vector<int>& positions)
 	{
-		for(size_t i = 0; i < vertexIndexList.size(); ++i)
+		const int numFlags = static_cast<int>(flags.size());
+		const int numBlocks = (numFlags+PREFIX_SUM_BLOCK_SIZE-1)/PREFIX_SUM_BLOCK_SIZE;
+
+		std::vector<int> blockOffsets(numBlocks+1, 0);
+
+#pragma omp parallel for
+		for(int iBlock = 0; iBlock < numBlocks; ++iBlock)
+		{
+			const int begin = iBlock*PREFIX_SUM_BLOCK_SIZE;
+			const int end = std::min(begin+PREFIX_SUM_BLOCK_SIZE, numFlags);
+			blockOffsets[iBlock+1] = static_cast<int>(std::count(flags.begin()+begin, flags.begin()+end, 1));
+		}
+
+		for(int iBlock = 0; iBlock < numBlocks; ++iBlock)
+		{
+			blockOffsets[iBlock+1] += blockOffsets[iBlock];
+		}
+
+		positions.resize(numFlags);
+
+#pragma omp parallel for
+		for(int iBlock = 0; iBlock < numBlocks; ++iBlock)
 		{
-			const std::vector<int>& currPolygonIndices = vertexIndexList[i];
-			for(size_t j = 0; j < currPolygonIndices.size(); ++j)
+			const int end = std::min((iBlock+1)*PREFIX_SUM_BLOCK_SIZE, numFlags);
+
+			int position = blockOffsets[iBlock];
+			for(int i = iBlock*PREFIX_SUM_BLOCK_SIZE; i < end; ++i)
 			{
-				const int currIndex = currPolygonIndices[j];
-
-				std::map<int, std::vector<size_t>>::iterator mapIter = polygonsForVertexIndexMap.find(currIndex);
-				if(mapIter!=polygonsForVertexIndexMap.end())
-				{
-					std::vector<size_t>& vec = mapIter->second;
-					vec.push_back(i);
-				}
-				else
-				{
-					std::vector<size_t> vec;
-					vec.push_back(i);
-					polygonsForVertexIndexMap.insert(std::make_pair(currIndex, vec));
-				}
+				positions[i] = position;
+				position += flags[i];
 			}
 		}
+
+		return blockOffsets[numBlocks];
 	}
+}
 
-	const size_t vertexNormalDim = vertexList.size();
-	vertexNormals.resize(vertexNormalDim, 0.0);
-	
-	std::map<int, std::vector<size_t>>::const_iterator currPointPolyIter = polygonsForVertexIndexMap.begin();
-	std::map<int, std::vector<size_t>>::const_iterator endPointPolyIter = polygonsForVertexIndexMap.end();
-	for(; currPointPolyIter != endPointPolyIter; ++currPointPolyIter)
-	{
-		const int currIndex = currPointPolyIter->first;
-		const std::vector<size_t>& neighborPolygons = currPointPolyIter->second;
+void MathHelper::computeVertexNormals(const DataContainer& poly, std::vector<double>& vertexNormals)
+{
+	const MeshTopology topology(poly, false);
+	MathHelper::computeVertexNormals(poly.getVertexList(), poly.getTriangleList(), topology, vertexNormals);
+}
 
+void MathHelper::computeVertexNormals(const std::vector<double>& vertexList, const std::vector<int>& triangles, const MeshTopology& topology, std::vector<double>& vertexNormals)
+{
+	const std::vector<int>& cornerOffsets = topology.getCornerOffsets();
+	const std::vector<int>& corners = topology.getCorners();
+	const int numVertices = static_cast<int>(vertexList.size()/3);
+
+	vertexNormals.assign(vertexList.size(), 0.0);
+
+	//The normal of each vertex only depends on its own triangles, the corner gives the position of the vertex within the triangle
+#pragma omp parallel for
+	for(int currIndex = 0; currIndex < numVertices; ++currIndex)
+	{
 		const Vec3d currVertex(vertexList[3*currIndex], vertexList[3*currIndex+1], vertexList[3*currIndex+2]);
 		Vec3d vertexNormal(0.0, 0.0, 0.0);
 
-		for(size_t i = 0; i < neighborPolygons.size(); ++i)
+		for(int i = cornerOffsets[currIndex]; i < cornerOffsets[currIndex+1]; ++i)
 		{
-			const std::vector<int>& currPoly = vertexIndexList[neighborPolygons[i]];
-
-			const size_t currPolySize = currPoly.size();
-
-			int tmpPos(-1);
-			for(size_t j = 0; j < currPolySize; ++j)
-			{
-				tmpPos = currPoly[j] == currIndex ? static_cast<int>(j) : tmpPos;
-			}
-
-			if(tmpPos == -1 || currPoly[tmpPos] != currIndex)
-			{
-#ifdef DEBUG_OUTPUT
-				std::cout << "Wrong neighboring index while computing normal vector" << std::endl;
-#endif
-				continue;
-			}
+			const int corner = corners[i];
+			const int* currPoly = &triangles[corner-corner%3];
 
-			const int prevIndex = currPoly[(tmpPos+(currPolySize-1))%currPolySize];
-			const int nextIndex = currPoly[(tmpPos+1)%currPolySize];
+			const int prevIndex = currPoly[(corner+2)%3];
+			const int nextIndex = currPoly[(corner+1)%3];
 
 			const Vec3d prevVertex(vertexList[3*prevIndex], vertexList[3*prevIndex+1], vertexList[3*prevIndex+2]);
 			const Vec3d nextVertex(vertexList[3*nextIndex], vertexList[3*nextIndex+1], vertexList[3*nextIndex+2]);
@@ -165,10 +174,7 @@ void MathHelper::getPlaneProjection(const Vec3d& p1, const Vec3d& p2, const Vec3
 
 void MathHelper::transformMesh(const double s, const std::vector<double>& R, const std::string& sstrRotOp, const std::vector<double>& t, const std::string& sstrTransOp, DataContainer& mesh)
 {
-	std::vector<double> vertexList = mesh.getVertexList();
-	MathHelper::transformData(s, R, sstrRotOp, t, sstrTransOp, vertexList);
-
-	mesh.setVertexList(vertexList);
+	MathHelper::transformData(s, R, sstrRotOp, t, sstrTransOp, mesh.getMutableVertexList());
 }
 
 void MathHelper::transformData(const double s, const std::vector<double>& R, const std::string& sstrRotOp, const std::vector<double>& t, const std::string& sstrTransOp, std::vector<double>& data)
@@ -501,134 +507,150 @@ void MathHelper::scaleData(const double factor, std::vector<double>& data)
 	}
 }
 
-void MathHelper::cleanMesh(DataContainer& mesh)
+void MathHelper::cleanMesh(DataContainer& mesh, std::ostream& logStream)
 {
-	std::set<size_t> validPointIndices;
+	std::vector<double>& vertices = mesh.getMutableVertexList();
+	std::vector<double>& vertexColors = mesh.getMutableVertexColorList();
+	std::vector<int>& triangles = mesh.getMutableTriangleList();
+
+	const int numVertices = static_cast<int>(mesh.getNumVertices());
+	const int numTriangles = static_cast<int>(mesh.getNumFaces());
 
-	const std::vector<std::vector<int>>& vertexIndexList = mesh.getVertexIndexList();
-	for(size_t i = 0; i < vertexIndexList.size(); ++i)
+	//Colors not matching the vertices are dropped
+	const bool bHasVertexColors(vertexColors.size() == vertices.size());
+	if(!bHasVertexColors)
 	{
-		const std::vector<int>& currPolygonIndices = vertexIndexList[i];
-		const size_t currPolygonSize = currPolygonIndices.size();
+		vertexColors.clear();
+	}
 
-		size_t numDisjointVertices(0);
-		for(size_t j = 0; j < currPolygonSize; ++j)
-		{
-			const size_t i1 = j;
-			const size_t i2 = (j+1)%currPolygonSize;
+	//Triangles with out-of-range indices or less than 3 disjoint vertices are removed, vertices are kept if they are referenced by a valid triangle.
+	//All triangles referencing a vertex write the same flag.
+	std::vector<char> validTriangles(numTriangles);
+	std::vector<char> referencedVertices(numVertices, 0);
 
-			if(currPolygonIndices[i1] != currPolygonIndices[i2])
-			{
-				++numDisjointVertices;
-			}
+	int numValidTriangles(0);
+	int numOutOfRangeTriangles(0);
+
+#pragma omp parallel for reduction(+:numValidTriangles,numOutOfRangeTriangles)
+	for(int i = 0; i < numTriangles; ++i)
+	{
+		const int* currTriangle = &triangles[3*i];
+
+		bool bInRange(true);
+		for(size_t j = 0; j < 3; ++j)
+		{
+			bInRange = bInRange && currTriangle[j] >= 0 && currTriangle[j] < numVertices;
 		}
 
-		if(numDisjointVertices < 3)
+		const bool bValid = bInRange && currTriangle[0] != currTriangle[1] && currTriangle[1] != currTriangle[2] && currTriangle[2] != currTriangle[0];
+
+		validTriangles[i] = bValid;
+		if(!bValid)
 		{
+			numOutOfRangeTriangles += !bInRange;
 			continue;
 		}
 
-		for(size_t j = 0; j < currPolygonSize; ++j)
+		for(size_t j = 0; j < 3; ++j)
 		{
-			validPointIndices.insert(currPolygonIndices[j]);
+#pragma omp atomic write
+			referencedVertices[currTriangle[j]] = 1;
 		}
-	}
 
+		++numValidTriangles;
+	}
 
-	std::vector<double> meshVertices = mesh.getVertexList();
-	std::vector<double> meshVertexColors = mesh.getVertexColorList();
-	bool bHasVertexColors(meshVertices.size() == meshVertexColors.size());
+	int numReferencedVertices(0);
 
-	std::vector<std::pair<int, int>> oldNewMap;
+#pragma omp parallel for reduction(+:numReferencedVertices)
+	for(int i = 0; i < numVertices; ++i)
+	{
+		numReferencedVertices += referencedVertices[i];
+	}
 
-	size_t newId = 0;
-	for(size_t id = 0; id < mesh.getNumVertices(); ++id)
+	if(numValidTriangles == numTriangles && numReferencedVertices == numVertices)
 	{
-		if(validPointIndices.find(id) == validPointIndices.end())
-		{
-			oldNewMap.push_back(std::make_pair(static_cast<int>(id), -1));
-		}
-		else
-		{
-			oldNewMap.push_back(std::make_pair(static_cast<int>(id), static_cast<int>(newId)));
-			++newId;
-		}
+		return;
 	}
 
-	DataContainer cleanMesh = mesh;
+	//New index of each referenced vertex and new position of each valid triangle
+	std::vector<int> newVertexIndices;
+	computeFlagPositions(referencedVertices, newVertexIndices);
 
-	std::vector<double> cleanMeshVertices;
-	std::vector<double> cleanMeshVertexColors;
+	std::vector<int> newTrianglePositions;
+	computeFlagPositions(validTriangles, newTrianglePositions);
 
-	for(size_t oldId = 0; oldId < mesh.getNumVertices(); ++oldId)
+#pragma omp parallel for
+	for(int i = 0; i < numTriangles; ++i)
 	{
-		const int newPointId = oldNewMap[oldId].second;
-		if(newPointId == -1)
+		if(!validTriangles[i])
 		{
 			continue;
 		}
-		
-		cleanMeshVertices.push_back(meshVertices[3*oldId]);
-		cleanMeshVertices.push_back(meshVertices[3*oldId+1]);
-		cleanMeshVertices.push_back(meshVertices[3*oldId+2]);
 
-		if(bHasVertexColors)
+		for(size_t j = 0; j < 3; ++j)
 		{
-			cleanMeshVertexColors.push_back(meshVertexColors[3*oldId]);
-			cleanMeshVertexColors.push_back(meshVertexColors[3*oldId+1]);
-			cleanMeshVertexColors.push_back(meshVertexColors[3*oldId+2]);
+			triangles[3*i+j] = newVertexIndices[triangles[3*i+j]];
 		}
 	}
-	
-	cleanMesh.setVertexList(cleanMeshVertices);
-	cleanMesh.setVertexColorList(cleanMeshVertexColors);
 
-	std::vector<std::vector<int>> cleanMeshPolygons;
-	for(size_t i = 0; i < vertexIndexList.size(); ++i)
+	//Kept entries are moved in place, an entry never moves behind its old position and is not copied onto itself
+	for(int i = 0; i < numTriangles; ++i)
 	{
-		const std::vector<int>& currPolygonIndices = vertexIndexList[i];
-		const size_t currPolygonSize = currPolygonIndices.size();
-
-		size_t numDisjointVertices(0);
-		for(size_t j = 0; j < currPolygonSize; ++j)
+		if(validTriangles[i] && newTrianglePositions[i] != i)
 		{
-			const size_t i1 = j;
-			const size_t i2 = (j+1)%currPolygonSize;
-
-			if(currPolygonIndices[i1] != currPolygonIndices[i2])
-			{
-				++numDisjointVertices;
-			}
+			std::copy(&triangles[3*i], &triangles[3*i]+3, &triangles[3*newTrianglePositions[i]]);
 		}
+	}
 
-		if(numDisjointVertices < 3)
+	for(int i = 0; i < numVertices; ++i)
+	{
+		const int newIndex = newVertexIndices[i];
+		if(!referencedVertices[i] || newIndex == i)
 		{
 			continue;
 		}
 
-		std::vector<int> newPolygonIndices;
-		for(size_t j = 0; j < currPolygonSize; ++j)
+		std::copy(&vertices[3*i], &vertices[3*i]+3, &vertices[3*newIndex]);
+
+		if(bHasVertexColors)
+		{
+			std::copy(&vertexColors[3*i], &vertexColors[3*i]+3, &vertexColors[3*newIndex]);
+		}
+	}
+
+	//Texture triangles belong to the triangles with the same index and are removed with them
+	const std::vector<std::vector<int>>& textureIndexList = mesh.getTextureIndexList();
+	if(numValidTriangles != numTriangles && static_cast<int>(textureIndexList.size()) == numTriangles)
+	{
+		std::vector<std::vector<int>> cleanTextureIndexList;
+		cleanTextureIndexList.reserve(numValidTriangles);
+		for(int i = 0; i < numTriangles; ++i)
 		{
-			const int newId = oldNewMap[currPolygonIndices[j]].second;
-			if(newId == -1)
+			if(validTriangles[i])
 			{
-				std::cout << "Error" << std::endl;
-				return;
+				cleanTextureIndexList.push_back(textureIndexList[i]);
 			}
-
-			newPolygonIndices.push_back(newId);
 		}
 
-		cleanMeshPolygons.push_back(newPolygonIndices);
+		mesh.setTextureIndexList(cleanTextureIndexList);
 	}
 
-	cleanMesh.setVertexIndexList(cleanMeshPolygons);
+	triangles.resize(3*numValidTriangles);
+	vertices.resize(3*numReferencedVertices);
+	if(bHasVertexColors)
+	{
+		vertexColors.resize(3*numReferencedVertices);
+	}
 
-	if(cleanMesh.getNumVertices() != mesh.getNumVertices())
+	if(numOutOfRangeTriangles > 0)
 	{
-		std::cout << "Removed " << mesh.getNumVertices() - cleanMesh.getNumVertices() << " vertices" << std::endl;
-		std::cout << "Removed " << mesh.getNumFaces() - cleanMesh.getNumFaces() << " faces" << std::endl;
+		logStream << "Removed " << numOutOfRangeTriangles << " faces with out-of-range vertex indices" << std::endl;
 	}
 
-	mesh = cleanMesh;
+	if(numReferencedVertices != numVertices)
+	{
+		logStream << "Removed " << numVertices - numReferencedVertices << " vertices" << std::endl;
+		logStream << "Removed " << numTriangles - numValidTriangles << " faces" << std::endl;
+	}
 }
\ No newline at end of file
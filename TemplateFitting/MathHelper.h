@@ -15,9 +15,11 @@
 #define MathHelper_H
 
 #include "DataContainer.h"
+#include "MeshTopology.h"
 #include "VectorNX.h"
 
 #include <set>
+#include <iostream>
 #include <stdlib.h>
 
 class MathHelper
@@ -26,9 +28,13 @@ public:
 	//! Compute normals, based on Max1999 - Weights for Computing Vertex Normals from Facet Normals
 	static void computeVertexNormals(const DataContainer& poly, std::vector<double>& vertexNormals);
 
+	//! Compute normals like computeVertexNormals(poly, vertexNormals) for the given vertices and triangles, with the vertex corners of the pre-computed topology of the triangles
+	static void computeVertexNormals(const std::vector<double>& vertexList, const std::vector<int>& triangles, const MeshTopology& topology, std::vector<double>& vertexNormals);
+
 	//Compute projection of p1 into tangential plane of p2
 	static void getPlaneProjection(const Vec3d& p1, const Vec3d& p2, const Vec3d& n2, Vec3d& outPoint);
 
+	//! Transforms the vertices of the mesh in place
 	static void transformMesh(const double s, const std::vector<double>& R, const std::string& sstrRotOp, const std::vector<double>& t, const std::string& sstrTransOp, DataContainer& mesh);
 
 	static void transformData(const double s, const std::vector<double>& R, const std::string& sstrRotOp, const std::vector<double>& t, const std::string& sstrTransOp, std::vector<double>& data);
@@ -49,7 +55,8 @@ public:
 
 	static void scaleData(const double factor, std::vector<double>& data);
 
-	static void cleanMesh(DataContainer& mesh);
+	//! Removes triangles with out-of-range indices or less than 3 disjoint vertices and all vertices not referenced by the remaining triangles, removals are reported to logStream
+	static void cleanMesh(DataContainer& mesh, std::ostream& logStream = std::cout);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "MeshTopology.h"
+
+#include <algorithm>
+
+MeshTopology::MeshTopology()
+: m_numVertices(0)
+{
+
+}
+
+MeshTopology::MeshTopology(const std::vector<int>& triangles, const size_t numVertices, const bool bNeighbors)
+: m_numVertices(0)
+{
+	compute(triangles, numVertices, bNeighbors);
+}
+
+MeshTopology::MeshTopology(const DataContainer& mesh, const bool bNeighbors)
+: m_numVertices(0)
+{
+	compute(mesh.getTriangleList(), mesh.getNumVertices(), bNeighbors);
+}
+
+MeshTopology::~MeshTopology()
+{
+
+}
+
+void MeshTopology::compute(const std::vector<int>& triangles, const size_t numVertices, const bool bNeighbors)
+{
+	const size_t numCorners = triangles.size();
+	const int numVerticesInt = static_cast<int>(numVertices);
+	m_numVertices = numVertices;
+
+	//Count the corners of each vertex, the prefix sum gives the start of the corners of each vertex
+	m_cornerOffsets.assign(numVertices+1, 0);
+	for(size_t i = 0; i < numCorners; ++i)
+	{
+		++m_cornerOffsets[triangles[i]+1];
+	}
+
+	for(size_t i = 0; i < numVertices; ++i)
+	{
+		m_cornerOffsets[i+1] += m_cornerOffsets[i];
+	}
+
+	//Corners are distributed in ascending order, such that the corners of each vertex are sorted
+	m_corners.resize(numCorners);
+
+	std::vector<int> currOffsets(m_cornerOffsets.begin(), m_cornerOffsets.end()-1);
+	for(size_t i = 0; i < numCorners; ++i)
+	{
+		m_corners[currOffsets[triangles[i]]++] = static_cast<int>(i);
+	}
+
+	m_neighborOffsets.clear();
+	m_neighbors.clear();
+	if(!bNeighbors)
+	{
+		return;
+	}
+
+	//Each vertex gathers the two other vertices of all its triangles, followed by sorting and removing duplicates per vertex
+	std::vector<int> tmpNeighbors(2*numCorners);
+	std::vector<int> numNeighbors(numVertices, 0);
+
+#pragma omp parallel for
+	for(int i = 0; i < numVerticesInt; ++i)
+	{
+		const std::vector<int>::iterator beginIter = tmpNeighbors.begin()+2*m_cornerOffsets[i];
+		std::vector<int>::iterator endIter = beginIter;
+
+		for(int k = m_cornerOffsets[i]; k < m_cornerOffsets[i+1]; ++k)
+		{
+			const int corner = m_corners[k];
+			const int* currTriangle = &triangles[corner-corner%3];
+			*endIter++ = currTriangle[(corner+1)%3];
+			*endIter++ = currTriangle[(corner+2)%3];
+		}
+
+		std::sort(beginIter, endIter);
+		numNeighbors[i] = static_cast<int>(std::unique(beginIter, endIter)-beginIter);
+	}
+
+	m_neighborOffsets.resize(numVertices+1);
+	m_neighborOffsets[0] = 0;
+	for(size_t i = 0; i < numVertices; ++i)
+	{
+		m_neighborOffsets[i+1] = m_neighborOffsets[i]+numNeighbors[i];
+	}
+
+	m_neighbors.resize(m_neighborOffsets[numVertices]);
+
+#pragma omp parallel for
+	for(int i = 0; i < numVerticesInt; ++i)
+	{
+		const std::vector<int>::const_iterator beginIter = tmpNeighbors.begin()+2*m_cornerOffsets[i];
+		std::copy(beginIter, beginIter+numNeighbors[i], m_neighbors.begin()+m_neighborOffsets[i]);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,61 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef MESHTOPOLOGY_H
+#define MESHTOPOLOGY_H
+
+#include "DataContainer.h"
+
+#include <vector>
+#include <stdlib.h>
+
+//! Connectivity of a triangle mesh in compressed row form, built in linear time by counting sort and prefix sums.
+//! Corner c is position c%3 of triangle c/3. The corners of vertex i are getCorners()[getCornerOffsets()[i]..getCornerOffsets()[i+1]-1] 
+//! in ascending order, such that the triangles of a vertex are given together with the position of the vertex within them.
+//! The neighbors of vertex i are getNeighbors()[getNeighborOffsets()[i]..getNeighborOffsets()[i+1]-1], sorted by index and without duplicates.
+class MeshTopology
+{
+public:
+	MeshTopology();
+
+	//! \param triangles			3 vertex indices per triangle
+	//! \param bNeighbors			compute the vertex neighbors, otherwise only the vertex corners are computed
+	MeshTopology(const std::vector<int>& triangles, const size_t numVertices, const bool bNeighbors = true);
+
+	MeshTopology(const DataContainer& mesh, const bool bNeighbors = true);
+
+	~MeshTopology();
+
+	size_t getNumVertices() const { return m_numVertices; }
+
+	//! Corners of all vertices in compressed row form, numVertices+1 offsets
+	const std::vector<int>& getCornerOffsets() const { return m_cornerOffsets; }
+	const std::vector<int>& getCorners() const { return m_corners; }
+
+	//! Vertex adjacency in compressed row form, numVertices+1 offsets, empty if the neighbors were not computed
+	const std::vector<int>& getNeighborOffsets() const { return m_neighborOffsets; }
+	const std::vector<int>& getNeighbors() const { return m_neighbors; }
+
+private:
+	void compute(const std::vector<int>& triangles, const size_t numVertices, const bool bNeighbors);
+
+	size_t m_numVertices;
+
+	std::vector<int> m_cornerOffsets;
+	std::vector<int> m_corners;
+
+	std::vector<int> m_neighborOffsets;
+	std::vector<int> m_neighbors;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,405 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+
+#include "SparseBlockCholesky.h"
+
+#include <algorithm>
+
+namespace clapack
+{
+	extern "C"
+	{
+		#include "blaswrap.h"
+		#include "f2c.h"
+		extern int dpotrf_(char *uplo, integer *n, doublereal *a, integer *lda, integer *info);
+		extern int dtrsm_(char *side, char *uplo, char *transa, char *diag, integer *m, integer *n
+								, doublereal *alpha, doublereal *a, integer *lda, doublereal *b, integer *ldb);
+		extern int dgemm_(char *transa, char *transb, integer *m, integer *n
+								, integer *k, doublereal *alpha, doublereal *a, integer *lda
+								, doublereal *b, integer *ldb, doublereal *beta, doublereal *c
+								, integer *ldc);
+		extern int dsyrk_(char *uplo, char *trans, integer *n, integer *k, doublereal *alpha
+								, doublereal *a, integer *lda, doublereal *beta, doublereal *c, integer *ldc);
+	}
+}
+
+namespace
+{
+	const int B = static_cast<int>(SparseBlockCholesky::BLOCK_SIZE);
+	const int BLOCK_VALUES = B*B;
+
+	//Number of block columns up to which a supernode may be extended by columns with a different structure
+	const int RELAXED_SUPERNODE_SIZE = 4;
+}
+
+SparseBlockCholesky::SparseBlockCholesky()
+: m_numBlocks(0)
+{
+
+}
+
+SparseBlockCholesky::~SparseBlockCholesky()
+{
+
+}
+
+bool SparseBlockCholesky::analyzePattern(const size_t numBlocks, const std::vector<int>& colPtr, const std::vector<int>& rowIndices)
+{
+	if(colPtr.size() != numBlocks+1 || rowIndices.size() != static_cast<size_t>(colPtr[numBlocks]))
+	{
+		return false;
+	}
+
+	const int n = static_cast<int>(numBlocks);
+
+	std::vector<int> parent(numBlocks, -1);
+	std::vector<int> colCounts(numBlocks, 0);
+	std::vector<int> flag(numBlocks, -1);
+
+	//Elimination tree and number of blocks per column of L (up-looking, see Davis - Direct Methods for Sparse Linear Systems)
+	for(int k = 0; k < n; ++k)
+	{
+		flag[k] = k;
+		for(int p = colPtr[k]; p < colPtr[k+1]; ++p)
+		{
+			int i = rowIndices[p];
+			if(i > k)
+			{
+				return false;
+			}
+
+			//Traverse from i towards the root of the elimination tree until a node of row k is reached
+			for(; flag[i] != k; i = parent[i])
+			{
+				if(parent[i] == -1)
+				{
+					parent[i] = k;
+				}
+
+				++colCounts[i];
+				flag[i] = k;
+			}
+		}
+	}
+
+	//Block rows of each column of L below the diagonal, the rows are visited in increasing order
+	std::vector<int> Lp(numBlocks+1, 0);
+	for(int k = 0; k < n; ++k)
+	{
+		Lp[k+1] = Lp[k]+colCounts[k];
+	}
+
+	std::vector<int> Li(Lp[n]);
+	std::vector<int> Lnz(Lp.begin(), Lp.end()-1);
+	flag.assign(numBlocks, -1);
+
+	for(int k = 0; k < n; ++k)
+	{
+		flag[k] = k;
+		for(int p = colPtr[k]; p < colPtr[k+1]; ++p)
+		{
+			for(int i = rowIndices[p]; flag[i] != k; i = parent[i])
+			{
+				Li[Lnz[i]++] = k;
+				flag[i] = k;
+			}
+		}
+	}
+
+	//Supernodes are chains of the elimination tree. A column continues the supernode of the previous column if it is its only child with the same structure,
+	//or if the supernode stays small enough that the explicit zeros of the previous columns are cheaper than separate dense operations
+	std::vector<int> numChildren(numBlocks, 0);
+	for(int k = 0; k < n; ++k)
+	{
+		if(parent[k] != -1)
+		{
+			++numChildren[parent[k]];
+		}
+	}
+
+	m_superStart.clear();
+	m_blockSupernode.resize(numBlocks);
+	for(int k = 0; k < n; ++k)
+	{
+		bool bContinue = k > 0 && parent[k-1] == k;
+		if(bContinue && (numChildren[k] != 1 || colCounts[k-1] != colCounts[k]+1))
+		{
+			bContinue = k-m_superStart.back() < RELAXED_SUPERNODE_SIZE;
+		}
+
+		if(!bContinue)
+		{
+			m_superStart.push_back(k);
+		}
+
+		m_blockSupernode[k] = static_cast<int>(m_superStart.size())-1;
+	}
+
+	m_superStart.push_back(n);
+
+	//The structure of the columns of a supernode is the structure of its last column
+	const size_t numSupernodes = m_superStart.size()-1;
+	m_structPtr.resize(numSupernodes+1);
+	m_structure.clear();
+	m_panelPtr.resize(numSupernodes+1);
+
+	m_structPtr[0] = 0;
+	m_panelPtr[0] = 0;
+	for(size_t s = 0; s < numSupernodes; ++s)
+	{
+		const int last = m_superStart[s+1]-1;
+		const int numColumns = last+1-m_superStart[s];
+		m_structure.insert(m_structure.end(), Li.begin()+Lp[last], Li.begin()+Lp[last+1]);
+		m_structPtr[s+1] = static_cast<int>(m_structure.size());
+
+		const size_t numRows = static_cast<size_t>(B)*(numColumns+m_structPtr[s+1]-m_structPtr[s]);
+		m_panelPtr[s+1] = m_panelPtr[s]+numRows*B*numColumns;
+	}
+
+	//Block (i,k) of A is the transposed block (k,i) of the lower triangle, which is stored in the panel of the supernode of column i
+	m_rowIndices = rowIndices;
+	m_valuePositions.resize(rowIndices.size());
+	for(int k = 0; k < n; ++k)
+	{
+		for(int p = colPtr[k]; p < colPtr[k+1]; ++p)
+		{
+			const int i = rowIndices[p];
+			const int s = m_blockSupernode[i];
+			const int first = m_superStart[s];
+			const int numColumns = m_superStart[s+1]-first;
+			const size_t numRows = static_cast<size_t>(B)*(numColumns+m_structPtr[s+1]-m_structPtr[s]);
+
+			int rowPosition = k-first;
+			if(k >= m_superStart[s+1])
+			{
+				rowPosition = numColumns+static_cast<int>(std::lower_bound(m_structure.begin()+m_structPtr[s], m_structure.begin()+m_structPtr[s+1], k)-(m_structure.begin()+m_structPtr[s]));
+			}
+
+			m_valuePositions[p] = m_panelPtr[s]+static_cast<size_t>(B*(i-first))*numRows+B*rowPosition;
+		}
+	}
+
+	m_numBlocks = numBlocks;
+
+	//The numeric factorization is allocated by the first factorization
+	m_L.clear();
+	return true;
+}
+
+bool SparseBlockCholesky::factorize(const std::vector<double>& values)
+{
+	if(values.size() != BLOCK_VALUES*m_rowIndices.size())
+	{
+		return false;
+	}
+
+	//Scatter A into the panels
+	m_L.assign(m_panelPtr.back(), 0.0);
+	for(size_t p = 0; p < m_rowIndices.size(); ++p)
+	{
+		const int s = m_blockSupernode[m_rowIndices[p]];
+		const size_t numRows = static_cast<size_t>(B)*(m_superStart[s+1]-m_superStart[s]+m_structPtr[s+1]-m_structPtr[s]);
+
+		const double* A = &values[BLOCK_VALUES*p];
+		double* L = &m_L[m_valuePositions[p]];
+		for(int r = 0; r < B; ++r)
+		{
+			for(int c = 0; c < B; ++c)
+			{
+				L[r*numRows+c] = A[B*r+c];
+			}
+		}
+	}
+
+	char uplo = 'L';
+	char side = 'R';
+	char transT = 'T';
+	char transN = 'N';
+	char diag = 'N';
+	double one = 1.0;
+	double zero = 0.0;
+
+	const size_t numSupernodes = m_superStart.size()-1;
+	for(size_t s = 0; s < numSupernodes; ++s)
+	{
+		const int first = m_superStart[s];
+		const int numStructure = m_structPtr[s+1]-m_structPtr[s];
+		const int* structure = numStructure > 0 ? &m_structure[m_structPtr[s]] : NULL;
+
+		clapack::integer numColumns = B*(m_superStart[s+1]-first);
+		clapack::integer numBelow = B*numStructure;
+		clapack::integer numRows = numColumns+numBelow;
+		clapack::integer info(0);
+
+		//Dense factorization of the diagonal block and the panel below
+		double* P = &m_L[m_panelPtr[s]];
+		clapack::dpotrf_(&uplo, &numColumns, P, &numRows, &info);
+		if(info != 0)
+		{
+			return false;
+		}
+
+		if(numBelow == 0)
+		{
+			continue;
+		}
+
+		clapack::dtrsm_(&side, &uplo, &transT, &diag, &numBelow, &numColumns, &one, P, &numRows, P+numColumns, &numRows);
+
+		m_update.resize(static_cast<size_t>(numBelow)*numBelow);
+		clapack::dsyrk_(&uplo, &transN, &numBelow, &numColumns, &one, P+numColumns, &numRows, &zero, &m_update[0], &numBelow);
+
+		//Subtract the lower triangle of the update from the panels of the supernodes of the structure rows
+		m_relativeRows.resize(numStructure);
+		for(int a = 0; a < numStructure;)
+		{
+			const int t = m_blockSupernode[structure[a]];
+			const int targetFirst = m_superStart[t];
+			const int targetEnd = m_superStart[t+1];
+			const int* targetStructure = &m_structure[m_structPtr[t]];
+			const size_t targetRows = static_cast<size_t>(B)*(targetEnd-targetFirst+m_structPtr[t+1]-m_structPtr[t]);
+
+			//The remaining structure rows are a subset of the rows of the target panel
+			int targetPosition(0);
+			for(int b = a; b < numStructure; ++b)
+			{
+				if(structure[b] < targetEnd)
+				{
+					m_relativeRows[b] = structure[b]-targetFirst;
+				}
+				else
+				{
+					while(targetStructure[targetPosition] != structure[b])
+					{
+						++targetPosition;
+					}
+
+					m_relativeRows[b] = targetEnd-targetFirst+targetPosition;
+				}
+			}
+
+			int aEnd = a;
+			for(; aEnd < numStructure && structure[aEnd] < targetEnd; ++aEnd)
+			{
+				for(int c = 0; c < B; ++c)
+				{
+					const int updateColumn = B*aEnd+c;
+					const double* update = &m_update[static_cast<size_t>(updateColumn)*numBelow];
+					double* target = &m_L[m_panelPtr[t]+static_cast<size_t>(B*(structure[aEnd]-targetFirst)+c)*targetRows];
+
+					for(int r = c; r < B; ++r)
+					{
+						target[B*m_relativeRows[aEnd]+r] -= update[B*aEnd+r];
+					}
+
+					for(int b = aEnd+1; b < numStructure; ++b)
+					{
+						for(int r = 0; r < B; ++r)
+						{
+							target[B*m_relativeRows[b]+r] -= update[B*b+r];
+						}
+					}
+				}
+			}
+
+			a = aEnd;
+		}
+	}
+
+	return true;
+}
+
+void SparseBlockCholesky::solve(std::vector<double>& b, const size_t numRhs) const
+{
+	const size_t numSupernodes = m_superStart.size()-1;
+
+	//The right hand sides are a column-major numRhs x n matrix, the transposed system X^T*L*L^T = B^T is solved
+	char uplo = 'L';
+	char side = 'R';
+	char transT = 'T';
+	char transN = 'N';
+	char diag = 'N';
+	double one = 1.0;
+	double minusOne = -1.0;
+	double zero = 0.0;
+
+	clapack::integer R = static_cast<clapack::integer>(numRhs);
+
+	//Right hand sides of the structure rows of a supernode
+	std::vector<double> structureValues;
+
+	//L*Y=B
+	for(size_t s = 0; s < numSupernodes; ++s)
+	{
+		const int numStructure = m_structPtr[s+1]-m_structPtr[s];
+		const int* structure = numStructure > 0 ? &m_structure[m_structPtr[s]] : NULL;
+
+		clapack::integer numColumns = B*(m_superStart[s+1]-m_superStart[s]);
+		clapack::integer numBelow = B*numStructure;
+		clapack::integer numRows = numColumns+numBelow;
+
+		double* P = const_cast<double*>(&m_L[m_panelPtr[s]]);
+		double* x = &b[static_cast<size_t>(B)*m_superStart[s]*numRhs];
+
+		clapack::dtrsm_(&side, &uplo, &transT, &diag, &R, &numColumns, &one, P, &numRows, x, &R);
+
+		if(numBelow == 0)
+		{
+			continue;
+		}
+
+		structureValues.resize(static_cast<size_t>(numBelow)*numRhs);
+		clapack::dgemm_(&transN, &transT, &R, &numBelow, &numColumns, &one, x, &R, P+numColumns, &numRows, &zero, &structureValues[0], &R);
+
+		const size_t blockRhs = B*numRhs;
+		for(int a = 0; a < numStructure; ++a)
+		{
+			double* bRow = &b[blockRhs*structure[a]];
+			const double* update = &structureValues[blockRhs*a];
+			for(size_t j = 0; j < blockRhs; ++j)
+			{
+				bRow[j] -= update[j];
+			}
+		}
+	}
+
+	//L^T*X=Y
+	for(int s = static_cast<int>(numSupernodes)-1; s >= 0; --s)
+	{
+		const int numStructure = m_structPtr[s+1]-m_structPtr[s];
+		const int* structure = numStructure > 0 ? &m_structure[m_structPtr[s]] : NULL;
+
+		clapack::integer numColumns = B*(m_superStart[s+1]-m_superStart[s]);
+		clapack::integer numBelow = B*numStructure;
+		clapack::integer numRows = numColumns+numBelow;
+
+		double* P = const_cast<double*>(&m_L[m_panelPtr[s]]);
+		double* x = &b[static_cast<size_t>(B)*m_superStart[s]*numRhs];
+
+		if(numBelow > 0)
+		{
+			const size_t blockRhs = B*numRhs;
+			structureValues.resize(static_cast<size_t>(numBelow)*numRhs);
+			for(int a = 0; a < numStructure; ++a)
+			{
+				const double* bRow = &b[blockRhs*structure[a]];
+				std::copy(bRow, bRow+blockRhs, structureValues.begin()+blockRhs*a);
+			}
+
+			clapack::dgemm_(&transN, &transN, &R, &numColumns, &numBelow, &minusOne, &structureValues[0], &R, P+numColumns, &numRows, &one, x, &R);
+		}
+
+		clapack::dtrsm_(&side, &uplo, &transN, &diag, &R, &numColumns, &one, P, &numRows, x, &R);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,87 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+
+#ifndef SPARSEBLOCKCHOLESKY_H
+#define SPARSEBLOCKCHOLESKY_H
+
+#include <vector>
+#include <stdlib.h>
+
+//! Supernodal sparse Cholesky factorization L*L^T of symmetric positive definite matrices made of dense 4x4 blocks, without pivoting.
+//! The symbolic factorization (elimination tree, supernodes and their row structure) only depends on the block sparsity pattern and is computed on the blocks.
+//! It is computed once by analyzePattern and reused by every following numeric factorization of matrices with the same pattern.
+//! Consecutive block columns with the same structure form a supernode, which is factorized as a dense panel with LAPACK.
+class SparseBlockCholesky
+{
+public:
+	//! Dimension of the dense blocks
+	static const size_t BLOCK_SIZE = 4;
+
+	SparseBlockCholesky();
+
+	~SparseBlockCholesky();
+
+	//! Symbolic factorization. The block pattern is given by its upper triangular part (including the diagonal) in compressed column form.
+	//! \param numBlocks			number of block rows and block columns
+	//! \param colPtr			start of each block column within rowIndices, numBlocks+1 values
+	//! \param rowIndices		sorted block row indices of the blocks of each column, all less or equal than the column index
+	//! \return true if successful
+	bool analyzePattern(const size_t numBlocks, const std::vector<int>& colPtr, const std::vector<int>& rowIndices);
+
+	//! Numeric factorization of a matrix with the analyzed pattern.
+	//! \param values			row-major 4x4 blocks of the matrix, in the order of rowIndices
+	//! \return false if the matrix is not positive definite
+	bool factorize(const std::vector<double>& values);
+
+	//! Solves A*X=B in place using the last numeric factorization.
+	//! \param b					right hand sides, the numRhs values of each matrix row are consecutive, overwritten by the solution
+	//! \param numRhs			number of right hand sides
+	void solve(std::vector<double>& b, const size_t numRhs) const;
+
+	size_t getNumBlocks() const { return m_numBlocks; }
+
+	size_t getNumSupernodes() const { return m_superStart.empty() ? 0 : m_superStart.size()-1; }
+
+	//! Number of values of L, including the upper triangles of the dense diagonal blocks of the supernodes
+	size_t getNumFactorValues() const { return m_panelPtr.empty() ? 0 : m_panelPtr.back(); }
+
+private:
+	size_t m_numBlocks;
+
+	//First block column of each supernode, numSupernodes+1 values, and supernode of each block column
+	std::vector<int> m_superStart;
+	std::vector<int> m_blockSupernode;
+
+	//Block rows of each supernode below its diagonal block
+	std::vector<int> m_structPtr;
+	std::vector<int> m_structure;
+
+	//Start of the column-major dense panel of each supernode within m_L, numSupernodes+1 values
+	std::vector<size_t> m_panelPtr;
+
+	//Block row of each block of A
+	std::vector<int> m_rowIndices;
+
+	//Position of the first value of each block of A within the panels, the block (i,k) of A is stored transposed as block (k,i) of L
+	std::vector<size_t> m_valuePositions;
+
+	//Numeric factorization
+	std::vector<double> m_L;
+
+	//Workspace of the numeric factorization
+	std::vector<double> m_update;
+	std::vector<int> m_relativeRows;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,54 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "TargetData.h"
+#include "MathHelper.h"
+#include "Timer.h"
+
+#include <iostream>
+
+TargetData::TargetData(const DataContainer& targetMesh, const Precision precision)
+: m_targetMesh(targetMesh)
+, m_topology(targetMesh, USE_COHERENT_SEARCH && !USE_SURFACE_CORRESPONDENCES)
+, m_pKDTree(NULL)
+, m_pBVH(NULL)
+{
+	MathHelper::computeVertexNormals(m_targetMesh.getVertexList(), m_targetMesh.getTriangleList(), m_topology, m_normals);
+
+	const std::vector<double>& targetVertices = m_targetMesh.getVertexList();
+
+	//Search structure, a kd tree over the vertices or a bounding volume hierarchy over the surface
+#ifdef OUTPUT_TIMING
+	Timer searchStructureTimer;
+#endif
+	if(USE_SURFACE_CORRESPONDENCES)
+	{
+		m_pBVH = new TriangleBVH(targetVertices, m_targetMesh.getTriangleList(), m_normals);
+#ifdef OUTPUT_TIMING
+		std::cout << "BVH construction (" << m_pBVH->getNumTriangles() << " triangles): " << searchStructureTimer.elapsedMilliseconds() << " ms" << std::endl;
+#endif
+		return;
+	}
+
+	const KDTree3::Backend builtinBackend = precision == PRECISION_FLOAT ? KDTree3::BACKEND_BUILTIN_FLOAT : KDTree3::BACKEND_BUILTIN;
+	m_pKDTree = new KDTree3(targetVertices, USE_ANN_KDTREE ? KDTree3::BACKEND_ANN : builtinBackend);
+#ifdef OUTPUT_TIMING
+	std::cout << "Kd tree construction (" << (m_pKDTree->getBackend() == KDTree3::BACKEND_ANN ? "ANN" : (m_pKDTree->getBackend() == KDTree3::BACKEND_BUILTIN_FLOAT ? "built-in float" : "built-in")) << ", " << m_targetMesh.getNumVertices() << " points): " << searchStructureTimer.elapsedMilliseconds() << " ms" << std::endl;
+#endif
+}
+
+TargetData::~TargetData()
+{
+	delete m_pKDTree;
+	delete m_pBVH;
+}
\ No newline at end of file
@@ -0,0 +1,68 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef TARGETDATA_H
+#define TARGETDATA_H
+
+#include "DataContainer.h"
+#include "Definitions.h"
+#include "KDTree3.h"
+#include "MeshTopology.h"
+#include "TriangleBVH.h"
+
+#include <vector>
+
+//! Pre-computed data of a fitting target: vertex normals, nearest neighbor search structure and, for the coherent search, the vertex adjacency.
+//! The target data is built once and only read during the fitting, several fittings to the same target can share it concurrently.
+class TargetData
+{
+public:
+	//! \param targetMesh			target mesh, referenced by the target data and must outlive it
+	//! \param precision			storage precision of the built-in kd tree
+	TargetData(const DataContainer& targetMesh, const Precision precision = FIT_PRECISION);
+
+	~TargetData();
+
+	const DataContainer& getMesh() const { return m_targetMesh; }
+
+	const std::vector<double>& getVertices() const { return m_targetMesh.getVertexList(); }
+
+	const std::vector<double>& getNormals() const { return m_normals; }
+
+	//! Vertex adjacency in compressed row form, empty if USE_COHERENT_SEARCH is disabled
+	const std::vector<int>& getNeighborOffsets() const { return m_topology.getNeighborOffsets(); }
+	const std::vector<int>& getNeighbors() const { return m_topology.getNeighbors(); }
+
+	//! Kd tree over the target vertices, NULL if USE_SURFACE_CORRESPONDENCES is enabled
+	const KDTree3* getKDTree() const { return m_pKDTree; }
+
+	//! Bounding volume hierarchy over the target surface, NULL if USE_SURFACE_CORRESPONDENCES is disabled
+	const TriangleBVH* getBVH() const { return m_pBVH; }
+
+private:
+	TargetData(const TargetData& targetData);
+
+	TargetData& operator=(const TargetData& targetData);
+
+	const DataContainer& m_targetMesh;
+
+	std::vector<double> m_normals;
+
+	//Vertex corners for the normals, with the vertex adjacency only for the coherent search
+	MeshTopology m_topology;
+
+	KDTree3* m_pKDTree;
+	TriangleBVH* m_pBVH;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,403 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "TemplateData.h"
+#include "TemplateFitting.h"
+#include "FileLoader.h"
+#include "MappedFile.h"
+#include "Definitions.h"
+#include "Timer.h"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+namespace
+{
+	//Identification and format version of the cache file, the version must be increased whenever the cached data changes
+	const char CACHE_MAGIC[8] = {'T', 'F', 'C', 'A', 'C', 'H', 'E', '\0'};
+	const uint32_t CACHE_VERSION = 3;
+
+	int getProcessId()
+	{
+#ifdef _WIN32
+		return _getpid();
+#else
+		return static_cast<int>(getpid());
+#endif
+	}
+
+	//64 bit FNV-1a hash
+	uint64_t computeHash(const char* data, const size_t size)
+	{
+		uint64_t hash = 14695981039346656037ULL;
+		for(size_t i = 0; i < size; ++i)
+		{
+			hash ^= static_cast<unsigned char>(data[i]);
+			hash *= 1099511628211ULL;
+		}
+
+		return hash;
+	}
+
+	//Sequential reading of values and arrays from a memory block with bounds checks
+	class CacheReader
+	{
+	public:
+		CacheReader(const char* data, const size_t size)
+		: m_pCurr(data)
+		, m_pEnd(data+size)
+		{
+
+		}
+
+		template<typename T>
+		bool read(T& value)
+		{
+			if(static_cast<size_t>(m_pEnd-m_pCurr) < sizeof(T))
+			{
+				return false;
+			}
+
+			memcpy(&value, m_pCurr, sizeof(T));
+			m_pCurr += sizeof(T);
+			return true;
+		}
+
+		template<typename T>
+		bool read(std::vector<T>& values)
+		{
+			uint64_t numValues(0);
+			if(!read(numValues) || numValues > static_cast<uint64_t>(m_pEnd-m_pCurr)/sizeof(T))
+			{
+				return false;
+			}
+
+			values.resize(static_cast<size_t>(numValues));
+			if(numValues > 0)
+			{
+				memcpy(&values[0], m_pCurr, static_cast<size_t>(numValues)*sizeof(T));
+			}
+
+			m_pCurr += static_cast<size_t>(numValues)*sizeof(T);
+			return true;
+		}
+
+		bool read(DataContainer& mesh)
+		{
+			std::vector<double> vertices;
+			std::vector<double> colors;
+			std::vector<int> triangles;
+			if(!read(vertices) || !read(colors) || !read(triangles))
+			{
+				return false;
+			}
+
+			mesh.clear();
+			mesh.setVertexColorList(std::move(colors));
+			return mesh.setVertexList(std::move(vertices)) && mesh.setTriangleList(std::move(triangles));
+		}
+
+		bool isAtEnd() const { return m_pCurr == m_pEnd; }
+
+	private:
+		const char* m_pCurr;
+		const char* m_pEnd;
+	};
+
+	template<typename T>
+	void writeValue(const T& value, std::ofstream& output)
+	{
+		output.write(reinterpret_cast<const char*>(&value), sizeof(T));
+	}
+
+	template<typename T>
+	void writeValues(const std::vector<T>& values, std::ofstream& output)
+	{
+		writeValue(static_cast<uint64_t>(values.size()), output);
+		if(!values.empty())
+		{
+			output.write(reinterpret_cast<const char*>(&values[0]), values.size()*sizeof(T));
+		}
+	}
+
+	void writeMesh(const DataContainer& mesh, std::ofstream& output)
+	{
+		writeValues(mesh.getVertexList(), output);
+		writeValues(mesh.getVertexColorList(), output);
+		writeValues(mesh.getTriangleList(), output);
+	}
+}
+
+TemplateData::TemplateData()
+{
+
+}
+
+TemplateData::TemplateData(const DataContainer& templateMesh)
+: m_templateMesh(templateMesh)
+{
+	computeLevelData();
+}
+
+TemplateData::TemplateData(DataContainer&& templateMesh)
+: m_templateMesh(std::move(templateMesh))
+{
+	computeLevelData();
+}
+
+TemplateData::~TemplateData()
+{
+
+}
+
+TemplateData* TemplateData::load(const std::string& sstrTemplateFile)
+{
+#ifdef OUTPUT_TIMING
+	Timer setupTimer;
+#endif
+
+	//The cache is keyed by the content of the template file, which is hashed from its memory mapping
+	uint64_t templateHash(0);
+	bool bUseCache(false);
+	if(USE_TEMPLATE_CACHE)
+	{
+		MappedFile templateFile;
+		if(templateFile.open(sstrTemplateFile))
+		{
+			templateHash = computeHash(templateFile.getData(), templateFile.getSize());
+			bUseCache = true;
+		}
+	}
+
+	const std::string sstrCacheFile = TemplateData::getCacheFileName(sstrTemplateFile);
+
+	TemplateData* pTemplateData = new TemplateData();
+	if(bUseCache && pTemplateData->loadCache(sstrCacheFile, templateHash))
+	{
+#ifdef OUTPUT_TIMING
+		std::cout << "Template cache loaded: " << setupTimer.elapsedMilliseconds() << " ms" << std::endl;
+#endif
+		return pTemplateData;
+	}
+
+	FileLoader loader;
+	if(!FileLoader::fileExist(sstrTemplateFile) || !loader.loadFile(sstrTemplateFile, pTemplateData->m_templateMesh))
+	{
+		delete pTemplateData;
+		return NULL;
+	}
+
+	pTemplateData->computeLevelData();
+
+#ifdef OUTPUT_TIMING
+	std::cout << "Template setup: " << setupTimer.elapsedMilliseconds() << " ms" << std::endl;
+#endif
+
+	//Texture data is not cached
+	if(bUseCache && pTemplateData->m_templateMesh.getTextureList().empty() && !pTemplateData->saveCache(sstrCacheFile, templateHash))
+	{
+		std::cout << "Unable to save template cache " << sstrCacheFile << std::endl;
+	}
+
+	return pTemplateData;
+}
+
+std::string TemplateData::getCacheFileName(const std::string& sstrTemplateFile)
+{
+	return sstrTemplateFile + ".cache";
+}
+
+void TemplateData::computeLevelData()
+{
+	TemplateFitting::computeTemplateHierarchy(m_templateMesh, NUM_COARSE_LEVELS, MIN_NUM_LEVEL_VERTICES, m_coarseTemplates, m_coarseParents, m_topologies);
+
+	const size_t numCoarseLevels = m_coarseTemplates.size();
+
+	//The first vertex of a cluster becomes the coarse vertex, which is the lowest vertex index mapped to it
+	m_coarseVertexIndices.resize(numCoarseLevels);
+	for(size_t level = 1; level <= numCoarseLevels; ++level)
+	{
+		const std::vector<int>& parents = m_coarseParents[level-1];
+		std::vector<int>& coarseVertexIndices = m_coarseVertexIndices[level-1];
+		coarseVertexIndices.resize(m_coarseTemplates[level-1].getNumVertices(), -1);
+
+		for(size_t i = 0; i < parents.size(); ++i)
+		{
+			int& index = coarseVertexIndices[parents[i]];
+			if(index < 0)
+			{
+				index = level == 1 ? static_cast<int>(i) : m_coarseVertexIndices[level-2][i];
+			}
+		}
+	}
+
+	computeSolvers();
+}
+
+void TemplateData::computeSolvers()
+{
+	m_solvers.clear();
+	if(SOLVER_TYPE != SOLVER_GAUSS_NEWTON)
+	{
+		return;
+	}
+
+	const size_t numLevels = m_topologies.size();
+	m_solvers.reserve(numLevels);
+	for(size_t level = 0; level < numLevels; ++level)
+	{
+		const MeshTopology& topology = m_topologies[level];
+		m_solvers.push_back(GaussNewtonSolver(getLevelMesh(level).getVertexList(), topology.getNeighborOffsets(), topology.getNeighbors()));
+	}
+}
+
+bool TemplateData::saveCache(const std::string& sstrCacheFile, const uint64_t templateHash) const
+{
+	//The cache is written to a temporary file of this process and renamed when complete, 
+	//such that concurrent runs neither read a partial cache nor write to the same temporary file
+	std::stringstream tmpFileStream;
+	tmpFileStream << sstrCacheFile << "." << getProcessId() << ".tmp";
+	const std::string sstrTmpFile = tmpFileStream.str();
+
+	std::ofstream output(sstrTmpFile.c_str(), std::ios::binary);
+	if(!output.is_open())
+	{
+		return false;
+	}
+
+	output.write(CACHE_MAGIC, sizeof(CACHE_MAGIC));
+	writeValue(CACHE_VERSION, output);
+	writeValue(templateHash, output);
+
+	//Hierarchy settings the cached levels were computed with
+	writeValue(static_cast<uint64_t>(NUM_COARSE_LEVELS), output);
+	writeValue(static_cast<uint64_t>(MIN_NUM_LEVEL_VERTICES), output);
+
+	writeMesh(m_templateMesh, output);
+
+	const size_t numCoarseLevels = m_coarseTemplates.size();
+	writeValue(static_cast<uint64_t>(numCoarseLevels), output);
+	for(size_t i = 0; i < numCoarseLevels; ++i)
+	{
+		writeMesh(m_coarseTemplates[i], output);
+		writeValues(m_coarseParents[i], output);
+		writeValues(m_coarseVertexIndices[i], output);
+	}
+
+	output.close();
+	if(!output.good())
+	{
+		remove(sstrTmpFile.c_str());
+		return false;
+	}
+
+	//Renaming replaces an existing cache at once, except on Windows, where the existing cache needs to be removed first
+	if(rename(sstrTmpFile.c_str(), sstrCacheFile.c_str()) == 0)
+	{
+		return true;
+	}
+
+	remove(sstrCacheFile.c_str());
+	if(rename(sstrTmpFile.c_str(), sstrCacheFile.c_str()) == 0)
+	{
+		return true;
+	}
+
+	remove(sstrTmpFile.c_str());
+	return false;
+}
+
+bool TemplateData::loadCache(const std::string& sstrCacheFile, const uint64_t templateHash)
+{
+	MappedFile cacheFile;
+	if(!cacheFile.open(sstrCacheFile))
+	{
+		return false;
+	}
+
+	CacheReader reader(cacheFile.getData(), cacheFile.getSize());
+
+	char magic[sizeof(CACHE_MAGIC)];
+	uint32_t version(0);
+	uint64_t hash(0);
+	uint64_t maxNumLevels(0);
+	uint64_t minNumLevelVertices(0);
+	if(!reader.read(magic) || memcmp(magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || !reader.read(version) || version != CACHE_VERSION
+		|| !reader.read(hash) || hash != templateHash || !reader.read(maxNumLevels) || maxNumLevels != NUM_COARSE_LEVELS
+		|| !reader.read(minNumLevelVertices) || minNumLevelVertices != MIN_NUM_LEVEL_VERTICES)
+	{
+		return false;
+	}
+
+	uint64_t numCoarseLevels(0);
+	if(!reader.read(m_templateMesh) || !reader.read(numCoarseLevels) || numCoarseLevels > NUM_COARSE_LEVELS)
+	{
+		return false;
+	}
+
+	m_coarseTemplates.resize(numCoarseLevels);
+	m_coarseParents.resize(numCoarseLevels);
+	m_coarseVertexIndices.resize(numCoarseLevels);
+	for(size_t i = 0; i < numCoarseLevels; ++i)
+	{
+		if(!reader.read(m_coarseTemplates[i]) || !reader.read(m_coarseParents[i]) || !reader.read(m_coarseVertexIndices[i]))
+		{
+			return false;
+		}
+	}
+
+	if(!reader.isAtEnd())
+	{
+		return false;
+	}
+
+	m_topologies.clear();
+	m_topologies.reserve(numCoarseLevels+1);
+	for(size_t level = 0; level <= numCoarseLevels; ++level)
+	{
+		m_topologies.push_back(MeshTopology(getLevelMesh(level)));
+	}
+
+	computeSolvers();
+	return true;
+}
+
+void TemplateData::getLevelVertices(const size_t level, const std::vector<double>& templateVertices, std::vector<double>& levelVertices) const
+{
+	if(level == 0)
+	{
+		levelVertices = templateVertices;
+		return;
+	}
+
+	const std::vector<int>& coarseVertexIndices = m_coarseVertexIndices[level-1];
+	const size_t numLevelVertices = coarseVertexIndices.size();
+
+	levelVertices.resize(3*numLevelVertices);
+	for(size_t i = 0; i < numLevelVertices; ++i)
+	{
+		const size_t vertexOffset = 3*coarseVertexIndices[i];
+		levelVertices[3*i+0] = templateVertices[vertexOffset+0];
+		levelVertices[3*i+1] = templateVertices[vertexOffset+1];
+		levelVertices[3*i+2] = templateVertices[vertexOffset+2];
+	}
+}
\ No newline at end of file
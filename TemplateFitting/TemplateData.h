@@ -0,0 +1,100 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef TEMPLATEDATA_H
+#define TEMPLATEDATA_H
+
+#include "DataContainer.h"
+#include "GaussNewtonSolver.h"
+#include "MeshTopology.h"
+
+#include <stdint.h>
+#include <vector>
+
+//! Pre-computed data of a fitting template: the coarse template hierarchy, the topology of all levels and, for SOLVER_GAUSS_NEWTON, the Gauss-Newton solvers of all levels.
+//! The template data only depends on the template topology, it is built once and shared read-only by concurrent fittings of the template, 
+//! which may use rigidly aligned copies of the template vertices.
+class TemplateData
+{
+public:
+	//! \param templateMesh			template mesh, copied into the template data
+	TemplateData(const DataContainer& templateMesh);
+
+	//! \param templateMesh			template mesh, moved into the template data without copying
+	TemplateData(DataContainer&& templateMesh);
+
+	~TemplateData();
+
+	//! Loads the template file and computes its template data. With USE_TEMPLATE_CACHE, the cleaned template and its template data are read from
+	//! the cache file next to the template instead, if the cache file matches the content of the template file. Otherwise the cache file is (re)written.
+	//! \return template data, NULL if the template file cannot be loaded
+	static TemplateData* load(const std::string& sstrTemplateFile);
+
+	//! Cache file of the template file
+	static std::string getCacheFileName(const std::string& sstrTemplateFile);
+
+	const DataContainer& getMesh() const { return m_templateMesh; }
+
+	//! Number of coarse levels, level 0 is the template itself
+	size_t getNumCoarseLevels() const { return m_coarseTemplates.size(); }
+
+	//! Template mesh of the level, the vertices of a coarse level are a subset of the template vertices
+	const DataContainer& getLevelMesh(const size_t level) const { return level == 0 ? m_templateMesh : m_coarseTemplates[level-1]; }
+
+	//! Maps each vertex of level-1 to its cluster vertex of level, for level >= 1
+	const std::vector<int>& getParents(const size_t level) const { return m_coarseParents[level-1]; }
+
+	//! Vertex corners and vertex adjacency of the level
+	const MeshTopology& getTopology(const size_t level) const { return m_topologies[level]; }
+
+	//! Gauss-Newton solver of the level with the pre-computed ordering and symbolic factorization, only available for SOLVER_GAUSS_NEWTON.
+	//! Fittings copy the solver for their numeric factorizations.
+	const GaussNewtonSolver& getSolver(const size_t level) const { return m_solvers[level]; }
+
+	//! Gathers the vertices of the level from the template vertices, which may differ from the vertices of the template mesh by an alignment
+	void getLevelVertices(const size_t level, const std::vector<double>& templateVertices, std::vector<double>& levelVertices) const;
+
+private:
+	TemplateData();
+
+	TemplateData(const TemplateData& templateData);
+
+	TemplateData& operator=(const TemplateData& templateData);
+
+	//! Computes the hierarchy and the topology of all levels of the template mesh
+	void computeLevelData();
+
+	//! Computes the Gauss-Newton solvers of all levels for SOLVER_GAUSS_NEWTON
+	void computeSolvers();
+
+	//! Writes the template mesh and the hierarchy to the binary cache file, tagged with the hash of the template file content
+	bool saveCache(const std::string& sstrCacheFile, const uint64_t templateHash) const;
+
+	//! Reads the template mesh and the hierarchy from the memory mapped cache file, the topology of the levels is recomputed in linear time. 
+	//! Fails if the cache file has a different version, template hash or hierarchy settings.
+	bool loadCache(const std::string& sstrCacheFile, const uint64_t templateHash);
+
+	DataContainer m_templateMesh;
+
+	std::vector<DataContainer> m_coarseTemplates;
+	std::vector<std::vector<int>> m_coarseParents;
+
+	//Index of the template vertex of each coarse level vertex
+	std::vector<std::vector<int>> m_coarseVertexIndices;
+
+	std::vector<MeshTopology> m_topologies;
+
+	std::vector<GaussNewtonSolver> m_solvers;
+};
+
+#endif
\ No newline at end of file
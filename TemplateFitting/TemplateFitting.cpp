@@ -13,165 +13,654 @@
 
 #include "TemplateFitting.h"
 #include "TemplateFittingCostFunction.h"
+#include "GaussNewtonSolver.h"
+#include "LBFGSMinimizer.h"
 #include "KDTree3.h"
 #include "VectorNX.h"
 #include "MathHelper.h"
 #include "Definitions.h"
+#include "Timer.h"
 
 #include <iostream>
-#include <set>
+#include <algorithm>
+#include <float.h>
 #include <vnl/vnl_cost_function.h>
 #include <vnl/algo/vnl_lbfgsb.h>
 
-void TemplateFitting::fitTemplate(const DataContainer& templateMesh, const DataContainer& targetMesh, DataContainer& outMesh)
+namespace
 {
+	double computeSqrDist(const double* point1, const double* point2)
+	{
+		const double dx = point1[0]-point2[0];
+		const double dy = point1[1]-point2[1];
+		const double dz = point1[2]-point2[2];
+		return dx*dx+dy*dy+dz*dz;
+	}
+}
+
+void TemplateFitting::fitTemplate(const DataContainer& templateMesh, const DataContainer& targetMesh, DataContainer& outMesh, const FitOptions& options)
+{
+	const TargetData targetData(targetMesh, options.precision);
+	TemplateFitting::fitTemplate(templateMesh, targetData, options, outMesh);
+}
+
+void TemplateFitting::fitTemplate(const DataContainer& templateMesh, const TargetData& targetData, const FitOptions& options, DataContainer& outMesh, FitStatistics* pStatistics)
+{
+	const TemplateData templateData(templateMesh);
+	TemplateFitting::fitTemplate(templateData, templateMesh.getVertexList(), targetData, options, outMesh, pStatistics);
+}
+
+void TemplateFitting::fitTemplate(const TemplateData& templateData, const std::vector<double>& templateVertices, const TargetData& targetData, const FitOptions& options, DataContainer& outMesh, FitStatistics* pStatistics)
+{
+	if(options.precision == PRECISION_FLOAT)
+	{
+		if(options.bVerbose)
+		{
+			std::cout << "Single precision fitting" << std::endl;
+		}
+
+		TemplateFitting::fitTemplate<float>(templateData, templateVertices, targetData, options, outMesh, pStatistics);
+	}
+	else
+	{
+		TemplateFitting::fitTemplate<double>(templateData, templateVertices, targetData, options, outMesh, pStatistics);
+	}
+}
+
+template<typename Scalar>
+void TemplateFitting::fitTemplate(const TemplateData& templateData, const std::vector<double>& templateVertices, const TargetData& targetData, const FitOptions& options, DataContainer& outMesh, FitStatistics* pStatistics)
+{
+	Timer fittingTimer;
+
+	//Progress output, discarded for quiet fittings
+	std::ostream logStream(options.bVerbose ? std::cout.rdbuf() : NULL);
+
 	//Initialize weights
-	double nnWeight = NN_WEIGHT;
-	double regWeight = REG_WEIGHT; 
-	double rigidWeight = RIGID_WEIGHT;
+	double nnWeight = options.nnWeight;
+	double regWeight = options.regWeight; 
+	double rigidWeight = options.rigidWeight;
 
-	const size_t numTemplateVertices = templateMesh.getNumVertices();
-	const size_t numParameter = 12*numTemplateVertices;
-	
-	//Pre-compute template edges
-	std::vector<std::pair<int,int>> templateEdges;
-	TemplateFitting::computeEdges(templateMesh, templateEdges);
+	const size_t maxNumIter = options.maxNumIter;
 
-	//Pre-compute target kd tree
-	const std::vector<double>& targetVertices = targetMesh.getVertexList();
-	KDTree3 targetKDTree(targetVertices);
+	//Pre-computed template hierarchy for the coarse-to-fine fitting, level 0 is the template itself and every coarser level clusters the vertices of the previous level
+	const size_t numCoarseLevels = templateData.getNumCoarseLevels();
 
-	//Pre-compute target normals
-	std::vector<double> targetNormals;
-	MathHelper::computeVertexNormals(targetMesh, targetNormals);
+	std::vector<size_t> iterationLevels;
+	TemplateFitting::computeIterationLevels(numCoarseLevels, maxNumIter, NUM_FULL_RESOLUTION_ITER, iterationLevels);
+
+	if(numCoarseLevels > 0 && options.bVerbose)
+	{
+		logStream << "Template hierarchy: " << templateData.getLevelMesh(0).getNumVertices();
+		for(size_t i = 1; i <= numCoarseLevels; ++i)
+		{
+			logStream << " / " << templateData.getLevelMesh(i).getNumVertices();
+		}
+		logStream << " vertices" << std::endl;
+	}
+
+	//Pre-computed target normals, adjacency and search structure
+	const std::vector<double>& targetVertices = targetData.getVertices();
+	const std::vector<double>& targetNormals = targetData.getNormals();
+	const std::vector<int>& targetNeighborOffsets = targetData.getNeighborOffsets();
+	const std::vector<int>& targetNeighbors = targetData.getNeighbors();
+
+	const KDTree3* pTargetKDTree = targetData.getKDTree();
+	const TriangleBVH* pTargetBVH = targetData.getBVH();
+
+	//Template level of the current iteration together with its vertices and solvers, set up whenever the level changes
+	size_t level = iterationLevels.empty() ? 0 : iterationLevels[0];
+	const DataContainer* pLevelTemplate(NULL);
+	std::vector<double> levelVertices;
+
+	GaussNewtonSolver* pSolver(NULL);
+	LBFGSMinimizer* pLBFGSMinimizer(NULL);
 
 	//Initialize transformation
-	vnl_vector<double> trafo(numParameter, 0.0);
-	for(size_t i = 0; i < numTemplateVertices; ++i)
+	const size_t numStartVertices = templateData.getLevelMesh(level).getNumVertices();
+
+	vnl_vector<double> trafo(12*numStartVertices, 0.0);
+	for(size_t i = 0; i < numStartVertices; ++i)
 	{
-		const size_t trafoOffset = 12*i;
-		trafo[trafoOffset+0] = 1.0;
-		trafo[trafoOffset+4] = 1.0;
-		trafo[trafoOffset+8] = 1.0;
+		trafo[TemplateFittingCostFunction<Scalar>::getParameterIndex(numStartVertices, i, 0)] = 1.0;
+		trafo[TemplateFittingCostFunction<Scalar>::getParameterIndex(numStartVertices, i, 4)] = 1.0;
+		trafo[TemplateFittingCostFunction<Scalar>::getParameterIndex(numStartVertices, i, 8)] = 1.0;
 	}		
 
-	//Initialize transform
+	//Transformed template vertices and their normals, reused in all iterations
 	std::vector<double> sourceVertices;
+	std::vector<double> sourceNormals;
+
+	//Correspondence buffers, reused in all iterations
+	std::vector<int> nearestNeighborIndices;
+	std::vector<double> nearestNeighborSqrDists;
+	std::vector<double> nearestNeighbors; 
+	std::vector<char> validValues;
 
-	//Initialize fitting template
-	DataContainer tmpMesh(templateMesh);
+	//Correspondences of the previous iteration
+	std::vector<int> prevNearestNeighborIndices;
+	std::vector<char> prevValidValues;
 
-	for(size_t iIter = 0; iIter < MAX_NUM_ITER; ++iIter)
+	//Template vertices of the previous nearest neighbor search
+	std::vector<double> prevSourceVertices;
+
+	//Template vertices transformed by the result of an iteration
+	std::vector<double> fittedVertices;
+
+	bool bConverged(false);
+	size_t numIter(0);
+
+	for(size_t iIter = 0; iIter < maxNumIter; ++iIter)
 	{
-		std::cout << "****************************************************" << std::endl;
-		std::cout << "Current iteration: " << iIter+1 << " of " << MAX_NUM_ITER << std::endl;
+		logStream << "****************************************************" << std::endl;
+		logStream << "Current iteration: " << iIter+1 << " of " << maxNumIter << std::endl;
 
-		TemplateFitting::updateTransformation(templateMesh.getVertexList(), trafo, sourceVertices);
-		tmpMesh.setVertexList(sourceVertices);
+		if(pLevelTemplate == NULL || iterationLevels[iIter] != level)
+		{
+			//Continue with the transformations of the coarser level
+			for(; level > iterationLevels[iIter]; --level)
+			{
+				const vnl_vector<double> coarseTrafo(trafo);
+				TemplateFitting::prolongateTransformation(templateData.getParents(level), coarseTrafo, trafo);
+			}
 
-		std::vector<double> sourceNormals;
-		MathHelper::computeVertexNormals(tmpMesh, sourceNormals);
+			pLevelTemplate = &templateData.getLevelMesh(level);
 
-		//Compute nearest neighbors used for current iteration
-		std::vector<double> nearestNeighbors; 
-		std::vector<bool> validValues;
-		TemplateFitting::computeNearestNeighbors(sourceVertices, sourceNormals, targetVertices, targetNormals, targetKDTree, MAX_NN_DIST, MAX_ANGLE, nearestNeighbors, validValues);
+			templateData.getLevelVertices(level, templateVertices, levelVertices);
 
-		TemplateFittingCostFunction fkt(templateMesh.getVertexList(), templateEdges, nearestNeighbors, validValues, nnWeight, regWeight, rigidWeight);
+			if(numCoarseLevels > 0)
+			{
+				logStream << "Template level " << level << " (" << pLevelTemplate->getNumVertices() << " vertices)" << std::endl;
+			}
 
-		vnl_lbfgsb minimizer(fkt);
-		minimizer.set_cost_function_convergence_factor(1e+7); 
-		minimizer.set_projected_gradient_tolerance(1e-5);		
-		minimizer.set_max_function_evals(100);
+			//The ordering and symbolic factorization of the Gauss-Newton solver are pre-computed by the template data, 
+			//the copy of this fitting only holds the numeric factorizations
+			delete pSolver;
+			pSolver = SOLVER_TYPE == SOLVER_GAUSS_NEWTON ? new GaussNewtonSolver(templateData.getSolver(level)) : NULL;
 
-#ifdef OUTPUT_TRACE
-		minimizer.set_trace(true);
+			//The L-BFGS minimizer carries its curvature pairs from one iteration to the next of the same level
+			delete pLBFGSMinimizer;
+			pLBFGSMinimizer = SOLVER_TYPE == SOLVER_LBFGS ? new LBFGSMinimizer(trafo.size()) : NULL;
+
+			prevNearestNeighborIndices.clear();
+			prevValidValues.clear();
+			prevSourceVertices.clear();
+		}
+
+		const DataContainer& levelTemplate = *pLevelTemplate;
+
+		//Normals of the transformed vertices are computed directly with the triangles of the level template
+		TemplateFitting::updateTransformation(levelVertices, trafo, sourceVertices);
+		MathHelper::computeVertexNormals(sourceVertices, levelTemplate.getTriangleList(), templateData.getTopology(level), sourceNormals);
+
+		//Compute nearest neighbors used for current iteration
+#ifdef OUTPUT_TIMING
+		Timer nnTimer;
 #endif
+		if(pTargetBVH != NULL)
+		{
+			TemplateFitting::computeNearestNeighbors(sourceVertices, sourceNormals, *pTargetBVH, options.maxNNDist, options.maxAngle
+																, nearestNeighborIndices, nearestNeighborSqrDists, nearestNeighbors, validValues);
+		}
+		else if(USE_COHERENT_SEARCH)
+		{
+			const size_t numQueries = TemplateFitting::computeCoherentNearestNeighbors(sourceVertices, prevSourceVertices, sourceNormals, targetVertices, targetNormals, targetNeighborOffsets, targetNeighbors
+																										, *pTargetKDTree, options.maxNNDist, options.maxAngle, COHERENT_SEARCH_RATIO
+																										, nearestNeighborIndices, nearestNeighborSqrDists, nearestNeighbors, validValues);
+			prevSourceVertices = sourceVertices;
 
-		vnl_vector<double> x = trafo;
-		minimizer.minimize(x);
+			logStream << "Coherent search: " << numQueries << " of " << levelTemplate.getNumVertices() << " vertices queried in the kd tree" << std::endl;
+		}
+		else
+		{
+			TemplateFitting::computeNearestNeighbors(sourceVertices, sourceNormals, targetVertices, targetNormals, *pTargetKDTree, options.maxNNDist, options.maxAngle
+																, nearestNeighborIndices, nearestNeighborSqrDists, nearestNeighbors, validValues);
+		}
+#ifdef OUTPUT_TIMING
+		const double nnTime = nnTimer.elapsedMilliseconds();
+		logStream << "Nearest neighbor search: " << nnTime << " ms (" << (nnTime > 0.0 ? 1000.0*levelTemplate.getNumVertices()/nnTime : 0.0) << " queries/s)" << std::endl;
+#endif
 
-		if(minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_FTOL
-		|| minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_XTOL
-		|| minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_XFTOL
-		|| minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_GTOL)
+		//Fraction of correspondences changed since the previous iteration of the same level, 1 for the first iteration of a level
+		const double correspondenceChange = TemplateFitting::computeCorrespondenceChange(prevNearestNeighborIndices, prevValidValues, nearestNeighborIndices, validValues);
+		if(pLBFGSMinimizer != NULL && !prevNearestNeighborIndices.empty() && correspondenceChange > LBFGS_RESET_FRACTION)
 		{
-			trafo = x;
+			logStream << "Reset L-BFGS history, " << 100.0*correspondenceChange << "% of the correspondences changed" << std::endl;
+			pLBFGSMinimizer->reset();
 		}
-		else if(minimizer.get_failure_code() == vnl_lbfgsb::FAILED_TOO_MANY_ITERATIONS)
+
+		prevNearestNeighborIndices = nearestNeighborIndices;
+		prevValidValues = validValues;
+
+		TemplateFittingCostFunction<Scalar> fkt(levelVertices, templateData.getTopology(level).getNeighborOffsets(), templateData.getTopology(level).getNeighbors(), nearestNeighbors, validValues, nnWeight, regWeight, rigidWeight);
+
+		//Energy before and after the minimization are both evaluated with the weights of this iteration
+		vnl_vector<double> gradient(trafo.size());
+		double startEnergy(0.0);
+		fkt.compute(trafo, &startEnergy, &gradient);
+
+#ifdef OUTPUT_TIMING
+		Timer minimizerTimer;
+#endif
+		if(pSolver != NULL)
 		{
-			std::cout << "Reached maximum number of function evaluations " << minimizer.get_failure_code() << std::endl;
-			if(minimizer.obj_value_reduced())
+			vnl_vector<double> x = trafo;
+			if(pSolver->minimize(levelVertices, fkt, validValues, nnWeight, regWeight, rigidWeight, x))
 			{
-				std::cout << "Function value reduced" << std::endl;
-				trafo = x;
+				trafo.swap(x);
 			}
 			else
 			{
-				std::cout << "Function value not reduced" << std::endl;
+				logStream << "Function value not reduced" << std::endl;
+			}
+		}
+		else if(pLBFGSMinimizer != NULL)
+		{
+			vnl_vector<double> x = trafo;
+			if(pLBFGSMinimizer->minimize(fkt, x))
+			{
+				trafo.swap(x);
+			}
+			else
+			{
+				logStream << "Function value not reduced" << std::endl;
 			}
 		}
 		else
 		{
-			std::cout << "Minimizer failed convergence " << minimizer.get_failure_code() << std::endl;
+			vnl_lbfgsb minimizer(fkt);
+			minimizer.set_cost_function_convergence_factor(1e+7); 
+			minimizer.set_projected_gradient_tolerance(1e-5);		
+			minimizer.set_max_function_evals(100);
+
+#ifdef OUTPUT_TRACE
+			minimizer.set_trace(true);
+#endif
+
+			vnl_vector<double> x = trafo;
+			minimizer.minimize(x);
+
+			if(minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_FTOL
+			|| minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_XTOL
+			|| minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_XFTOL
+			|| minimizer.get_failure_code() == vnl_lbfgsb::CONVERGED_GTOL)
+			{
+				trafo.swap(x);
+			}
+			else if(minimizer.get_failure_code() == vnl_lbfgsb::FAILED_TOO_MANY_ITERATIONS)
+			{
+				logStream << "Reached maximum number of function evaluations " << minimizer.get_failure_code() << std::endl;
+				if(minimizer.obj_value_reduced())
+				{
+					logStream << "Function value reduced" << std::endl;
+					trafo.swap(x);
+				}
+				else
+				{
+					logStream << "Function value not reduced" << std::endl;
+				}
+			}
+			else
+			{
+				logStream << "Minimizer failed convergence " << minimizer.get_failure_code() << std::endl;
+			}
 		}
+#ifdef OUTPUT_TIMING
+		const double minimizerTime = minimizerTimer.elapsedMilliseconds();
+		logStream << "Minimization: " << minimizerTime << " ms, " << fkt.getNumEvaluations() << " energy evaluations (" 
+					<< (minimizerTime > 0.0 ? 1000.0*fkt.getNumEvaluations()/minimizerTime : 0.0) << " evaluations/s)" << std::endl;
+#endif
+
+		double endEnergy(0.0);
+		fkt.compute(trafo, &endEnergy, &gradient);
+		const double relativeEnergyDecrease = startEnergy > 0.0 ? (startEnergy-endEnergy)/startEnergy : 0.0;
+
+		TemplateFitting::updateTransformation(levelVertices, trafo, fittedVertices);
+		const double maxDisplacement = TemplateFitting::computeMaxDisplacement(sourceVertices, fittedVertices);
+
+		logStream << "Changed correspondences: " << 100.0*correspondenceChange << "%, relative energy decrease: " << relativeEnergyDecrease 
+					<< ", maximum displacement: " << maxDisplacement << std::endl;
 
 		regWeight = regWeight / 2.0;
 		rigidWeight = rigidWeight / 2.0;
 
-		std::cout << "****************************************************" << std::endl;
+		//Stop early once correspondences, energy and vertex positions have settled on the full resolution template
+		if(level == 0 && iIter+1 < maxNumIter && correspondenceChange < options.convergenceCorrespondenceChange 
+			&& relativeEnergyDecrease < options.convergenceEnergyDecrease && maxDisplacement < options.convergenceMaxDisplacement)
+		{
+			logStream << "Converged after iteration " << iIter+1 << " of " << maxNumIter << ": changed correspondences " << 100.0*correspondenceChange << "% < " << 100.0*options.convergenceCorrespondenceChange 
+						<< "%, relative energy decrease " << relativeEnergyDecrease << " < " << options.convergenceEnergyDecrease 
+						<< ", maximum displacement " << maxDisplacement << " < " << options.convergenceMaxDisplacement << std::endl;
+
+			bConverged = true;
+		}
+
+		logStream << "****************************************************" << std::endl;
+
+		numIter = iIter+1;
+		if(bConverged)
+		{
+			break;
+		}
+	}
+
+	if(!bConverged)
+	{
+		logStream << "Stopped after the maximum number of " << maxNumIter << " iterations" << std::endl;
+	}
+
+	delete pSolver;
+	delete pLBFGSMinimizer;
+
+	for(; level > 0; --level)
+	{
+		const vnl_vector<double> coarseTrafo(trafo);
+		TemplateFitting::prolongateTransformation(templateData.getParents(level), coarseTrafo, trafo);
 	}
 
 	std::vector<double> outVertices;
-	TemplateFitting::updateTransformation(templateMesh.getVertexList(), trafo, outVertices);
+	TemplateFitting::updateTransformation(templateVertices, trafo, outVertices);
+
+	//The fitted vertices are moved into the output mesh, only the remaining template data is copied
+	const DataContainer& templateMesh = templateData.getMesh();
+
+	outMesh.clear();
+	outMesh.setVertexList(std::move(outVertices));
+	outMesh.setTriangleList(templateMesh.getTriangleList());
+	outMesh.setVertexColorList(templateMesh.getVertexColorList());
+	outMesh.setTextureList(templateMesh.getTextureList());
+	outMesh.setTextureIndexList(templateMesh.getTextureIndexList());
+	outMesh.setTextureName(templateMesh.getTextureName());
 
-	outMesh = templateMesh;
-	outMesh.setVertexList(outVertices);
+	if(pStatistics != NULL)
+	{
+		const size_t numValid = std::count(validValues.begin(), validValues.end(), 1);
+
+		pStatistics->numIterations = numIter;
+		pStatistics->bConverged = bConverged;
+		pStatistics->validFraction = validValues.empty() ? 0.0 : static_cast<double>(numValid)/static_cast<double>(validValues.size());
+		pStatistics->meanDistance = TemplateFitting::computeMeanTargetDistance(outMesh.getVertexList(), targetData);
+		pStatistics->time = fittingTimer.elapsedMilliseconds();
+	}
 }
 
 void TemplateFitting::computeNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& sourceNormals, const std::vector<double>& targetVertices, const std::vector<double>& targetNormals, const KDTree3& targetKDTree
-															, const double maxDist, const double maxAngle, std::vector<double>& nearestNeighbors, std::vector<bool>& validValues)
+															, const double maxDist, const double maxAngle, std::vector<int>& nearestNeighborIndices, std::vector<double>& nearestNeighborSqrDists
+															, std::vector<double>& nearestNeighbors, std::vector<char>& validValues)
 {
 	const size_t numVertices = sourceVertices.size()/3;
-	
-	nearestNeighbors.clear();
-	nearestNeighbors.resize(3*numVertices, 0.0);
 
-	validValues.clear();
-	validValues.resize(numVertices, false);
-	
-	for(size_t i = 0; i < numVertices; ++i)
+	nearestNeighborIndices.resize(numVertices);
+	nearestNeighborSqrDists.resize(numVertices);
+	nearestNeighbors.resize(3*numVertices);
+	validValues.resize(numVertices);
+
+	if(numVertices == 0)
+	{
+		return;
+	}
+
+	//Query all source vertices at once
+	if(!targetKDTree.getNearestPoints(&sourceVertices[0], numVertices, &nearestNeighborIndices[0], &nearestNeighborSqrDists[0]))
+	{
+		std::fill(nearestNeighborIndices.begin(), nearestNeighborIndices.end(), -1);
+	}
+
+	TemplateFitting::validateNearestNeighbors(sourceVertices, sourceNormals, targetVertices, targetNormals, maxDist, maxAngle, nearestNeighborIndices, nearestNeighborSqrDists, nearestNeighbors, validValues);
+}
+
+size_t TemplateFitting::computeCoherentNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& prevSourceVertices, const std::vector<double>& sourceNormals
+																			, const std::vector<double>& targetVertices, const std::vector<double>& targetNormals, const std::vector<int>& targetNeighborOffsets, const std::vector<int>& targetNeighbors
+																			, const KDTree3& targetKDTree, const double maxDist, const double maxAngle, const double maxDisplacementRatio
+																			, std::vector<int>& nearestNeighborIndices, std::vector<double>& nearestNeighborSqrDists, std::vector<double>& nearestNeighbors, std::vector<char>& validValues)
+{
+	const size_t numVertices = sourceVertices.size()/3;
+	if(prevSourceVertices.size() != sourceVertices.size() || nearestNeighborIndices.size() != numVertices || nearestNeighborSqrDists.size() != numVertices)
 	{
-		const Vec3d sourcePoint(sourceVertices[3*i],sourceVertices[3*i+1],sourceVertices[3*i+2]);
+		TemplateFitting::computeNearestNeighbors(sourceVertices, sourceNormals, targetVertices, targetNormals, targetKDTree, maxDist, maxAngle
+															, nearestNeighborIndices, nearestNeighborSqrDists, nearestNeighbors, validValues);
+		return numVertices;
+	}
+
+	nearestNeighbors.resize(3*numVertices);
+	validValues.resize(numVertices);
+
+	const double sqrDisplacementRatio = maxDisplacementRatio*maxDisplacementRatio;
 
-		std::vector<double> querySourcePoint;
-		querySourcePoint.push_back(sourcePoint[0]);
-		querySourcePoint.push_back(sourcePoint[1]);
-		querySourcePoint.push_back(sourcePoint[2]);
+	int numQueries(0);
 
-		int nnPointIndex(0);
-		double nnSqrPointDist(0);
-		targetKDTree.getNearestPoint(querySourcePoint, nnPointIndex, nnSqrPointDist);
+#pragma omp parallel for reduction(+:numQueries)
+	for(int i = 0; i < numVertices; ++i)
+	{
+		const size_t vertexOffset = 3*i;
+		const double* point = &sourceVertices[vertexOffset];
 
-		const Vec3d sourceNormal(sourceNormals[3*i], sourceNormals[3*i+1], sourceNormals[3*i+2]);
-		const Vec3d targetNormal(targetNormals[3*nnPointIndex], targetNormals[3*nnPointIndex+1], targetNormals[3*nnPointIndex+2]);
-		const double angle = sourceNormal.angle(targetNormal);
+		const double dx = point[0]-prevSourceVertices[vertexOffset+0];
+		const double dy = point[1]-prevSourceVertices[vertexOffset+1];
+		const double dz = point[2]-prevSourceVertices[vertexOffset+2];
+		const double sqrDisplacement = dx*dx+dy*dy+dz*dz;
+
+		//Vertices without previous match or with a large displacement compared to their previous nearest neighbor distance are queried from the root
+		int nnIndex = nearestNeighborIndices[i];
+		if(nnIndex < 0 || sqrDisplacement > sqrDisplacementRatio*nearestNeighborSqrDists[i])
+		{
+			if(!targetKDTree.getNearestPoint(point, nearestNeighborIndices[i], nearestNeighborSqrDists[i]))
+			{
+				nearestNeighborIndices[i] = -1;
+			}
 
-		bool bPointValid = (sqrt(nnSqrPointDist) <= maxDist) && (angle <= maxAngle);
+			++numQueries;
+			continue;
+		}
+
+		//Greedy walk over the target vertex adjacency, starting at the previous nearest neighbor
+		double nnSqrDist = computeSqrDist(point, &targetVertices[3*nnIndex]);
+		
+		bool bImproved(true);
+		while(bImproved)
+		{
+			bImproved = false;
+
+			const int currIndex = nnIndex;
+			for(int k = targetNeighborOffsets[currIndex]; k < targetNeighborOffsets[currIndex+1]; ++k)
+			{
+				const int neighbor = targetNeighbors[k];
+				const double sqrDist = computeSqrDist(point, &targetVertices[3*neighbor]);
+				if(sqrDist < nnSqrDist)
+				{
+					nnSqrDist = sqrDist;
+					nnIndex = neighbor;
+					bImproved = true;
+				}
+			}
+		}
+
+		nearestNeighborIndices[i] = nnIndex;
+		nearestNeighborSqrDists[i] = nnSqrDist;
+	}
+
+	TemplateFitting::validateNearestNeighbors(sourceVertices, sourceNormals, targetVertices, targetNormals, maxDist, maxAngle, nearestNeighborIndices, nearestNeighborSqrDists, nearestNeighbors, validValues);
+	return static_cast<size_t>(numQueries);
+}
+
+void TemplateFitting::validateNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& sourceNormals, const std::vector<double>& targetVertices, const std::vector<double>& targetNormals
+															, const double maxDist, const double maxAngle, const std::vector<int>& nearestNeighborIndices, const std::vector<double>& nearestNeighborSqrDists
+															, std::vector<double>& nearestNeighbors, std::vector<char>& validValues)
+{
+	const size_t numVertices = sourceVertices.size()/3;
+
+	//Compare squared distances and cosines against thresholds computed once instead of calling sqrt and acos per vertex
+	//Vec3d::angle clamps the angle to 0-90 degree, hence every threshold of at least 90 degree accepts all normals
+	const double maxSqrDist = maxDist*maxDist;
+	const double minCosAngle = maxAngle < 90.0 ? cos(maxAngle*M_PI/180.0) : 0.0;
+
+#pragma omp parallel for
+	for(int i = 0; i < numVertices; ++i)
+	{
+		const size_t vertexOffset = 3*i;
+
+		nearestNeighbors[vertexOffset+0] = 0.0;
+		nearestNeighbors[vertexOffset+1] = 0.0;
+		nearestNeighbors[vertexOffset+2] = 0.0;
+		validValues[i] = 0;
+
+		const int nnPointIndex = nearestNeighborIndices[i];
+		const double nnSqrPointDist = nearestNeighborSqrDists[i];
+		if(nnPointIndex < 0)
+		{
+			continue;
+		}
+
+		const size_t nnOffset = 3*nnPointIndex;
+
+		const Vec3d sourceNormal(sourceNormals[vertexOffset], sourceNormals[vertexOffset+1], sourceNormals[vertexOffset+2]);
+		const Vec3d targetNormal(targetNormals[nnOffset], targetNormals[nnOffset+1], targetNormals[nnOffset+2]);
+
+		const double normalLengths = sourceNormal.length()*targetNormal.length();
+		const double cosAngle = normalLengths > 0.0 ? std::max<double>(sourceNormal.dotProduct(targetNormal)/normalLengths, 0.0) : -1.0;
+
+		const bool bPointValid = (nnSqrPointDist <= maxSqrDist) && (cosAngle >= minCosAngle);
 		if(bPointValid)
 		{
-			const Vec3d nnPoint(targetVertices[3*nnPointIndex], targetVertices[3*nnPointIndex+1], targetVertices[3*nnPointIndex+2]);
+			const Vec3d sourcePoint(sourceVertices[vertexOffset], sourceVertices[vertexOffset+1], sourceVertices[vertexOffset+2]);
+			const Vec3d nnPoint(targetVertices[nnOffset], targetVertices[nnOffset+1], targetVertices[nnOffset+2]);
 
 			Vec3d planeProjectionPoint;					
 			MathHelper::getPlaneProjection(sourcePoint, nnPoint, targetNormal, planeProjectionPoint);
 
-			nearestNeighbors[3*i] = planeProjectionPoint[0];
-			nearestNeighbors[3*i+1] = planeProjectionPoint[1];
-			nearestNeighbors[3*i+2] = planeProjectionPoint[2];
+			nearestNeighbors[vertexOffset+0] = planeProjectionPoint[0];
+			nearestNeighbors[vertexOffset+1] = planeProjectionPoint[1];
+			nearestNeighbors[vertexOffset+2] = planeProjectionPoint[2];
+
+			validValues[i] = 1;
+		}
+	}
+}
+
+void TemplateFitting::computeNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& sourceNormals, const TriangleBVH& targetBVH
+															, const double maxDist, const double maxAngle, std::vector<int>& nearestFaceIndices, std::vector<double>& nearestSqrDists
+															, std::vector<double>& nearestNeighbors, std::vector<char>& validValues)
+{
+	const size_t numVertices = sourceVertices.size()/3;
+
+	nearestFaceIndices.resize(numVertices);
+	nearestSqrDists.resize(numVertices);
+	nearestNeighbors.resize(3*numVertices);
+	validValues.resize(numVertices);
+
+	const double maxSqrDist = maxDist*maxDist;
+	const double minCosAngle = maxAngle < 90.0 ? cos(maxAngle*M_PI/180.0) : 0.0;
+
+#pragma omp parallel for
+	for(int i = 0; i < numVertices; ++i)
+	{
+		const size_t vertexOffset = 3*i;
+
+		nearestNeighbors[vertexOffset+0] = 0.0;
+		nearestNeighbors[vertexOffset+1] = 0.0;
+		nearestNeighbors[vertexOffset+2] = 0.0;
+		validValues[i] = 0;
+
+		//Surface points beyond the maximum distance are invalid anyway and are pruned during the search
+		TriangleBVH::ClosestPoint closestPoint;
+		if(!targetBVH.getClosestPoint(&sourceVertices[vertexOffset], maxSqrDist, closestPoint))
+		{
+			nearestFaceIndices[i] = -1;
+			nearestSqrDists[i] = maxSqrDist;
+			continue;
+		}
+
+		nearestFaceIndices[i] = closestPoint.faceIndex;
+		nearestSqrDists[i] = closestPoint.sqrDist;
+
+		const Vec3d sourceNormal(sourceNormals[vertexOffset], sourceNormals[vertexOffset+1], sourceNormals[vertexOffset+2]);
+		const Vec3d targetNormal(closestPoint.normal[0], closestPoint.normal[1], closestPoint.normal[2]);
+
+		const double normalLengths = sourceNormal.length()*targetNormal.length();
+		const double cosAngle = normalLengths > 0.0 ? std::max<double>(sourceNormal.dotProduct(targetNormal)/normalLengths, 0.0) : -1.0;
+		if(cosAngle >= minCosAngle)
+		{
+			nearestNeighbors[vertexOffset+0] = closestPoint.point[0];
+			nearestNeighbors[vertexOffset+1] = closestPoint.point[1];
+			nearestNeighbors[vertexOffset+2] = closestPoint.point[2];
+
+			validValues[i] = 1;
+		}
+	}
+}
+
+double TemplateFitting::computeCorrespondenceChange(const std::vector<int>& prevIndices, const std::vector<char>& prevValidValues, const std::vector<int>& indices, const std::vector<char>& validValues)
+{
+	const size_t numVertices = indices.size();
+	if(numVertices == 0 || prevIndices.size() != numVertices || prevValidValues.size() != numVertices || validValues.size() != numVertices)
+	{
+		return 1.0;
+	}
+
+	int numChanged(0);
+
+#pragma omp parallel for reduction(+:numChanged)
+	for(int i = 0; i < numVertices; ++i)
+	{
+		if(prevValidValues[i] != validValues[i] || (validValues[i] && prevIndices[i] != indices[i]))
+		{
+			++numChanged;
+		}
+	}
+
+	return static_cast<double>(numChanged)/static_cast<double>(numVertices);
+}
+
+double TemplateFitting::computeMeanTargetDistance(const std::vector<double>& vertices, const TargetData& targetData)
+{
+	const size_t numVertices = vertices.size()/3;
+	if(numVertices == 0)
+	{
+		return 0.0;
+	}
+
+	double sumDist(0.0);
 
-			validValues[i] = true;
+#pragma omp parallel for reduction(+:sumDist)
+	for(int i = 0; i < numVertices; ++i)
+	{
+		const double* point = &vertices[3*i];
+		if(targetData.getBVH() != NULL)
+		{
+			TriangleBVH::ClosestPoint closestPoint;
+			if(targetData.getBVH()->getClosestPoint(point, DBL_MAX, closestPoint))
+			{
+				sumDist += sqrt(closestPoint.sqrDist);
+			}
+		}
+		else
+		{
+			int nnIndex(-1);
+			double nnSqrDist(0.0);
+			if(targetData.getKDTree()->getNearestPoint(point, nnIndex, nnSqrDist))
+			{
+				sumDist += sqrt(nnSqrDist);
+			}
 		}
 	}
+
+	return sumDist/static_cast<double>(numVertices);
+}
+
+double TemplateFitting::computeMaxDisplacement(const std::vector<double>& vertices1, const std::vector<double>& vertices2)
+{
+	const size_t numVertices = std::min(vertices1.size(), vertices2.size())/3;
+
+	double maxSqrDist(0.0);
+	for(size_t i = 0; i < numVertices; ++i)
+	{
+		const size_t vertexOffset = 3*i;
+		const double dx = vertices1[vertexOffset+0]-vertices2[vertexOffset+0];
+		const double dy = vertices1[vertexOffset+1]-vertices2[vertexOffset+1];
+		const double dz = vertices1[vertexOffset+2]-vertices2[vertexOffset+2];
+		maxSqrDist = std::max(maxSqrDist, dx*dx+dy*dy+dz*dz);
+	}
+
+	return sqrt(maxSqrDist);
 }
 
 void TemplateFitting::updateTransformation(const std::vector<double>& sourceVertices, const vnl_vector<double>& trafo, std::vector<double>& trafoVertices)
@@ -181,58 +670,170 @@ void TemplateFitting::updateTransformation(const std::vector<double>& sourceVert
 	trafoVertices.clear();
 	trafoVertices.resize(3*numSourceVertices, 0.0);
 
-//#pragma omp parallel for
+	//Parameter p of vertex i is stored at p*numSourceVertices+i
+	const double* params = trafo.data_block();
+	const size_t n = numSourceVertices;
+
+#pragma omp parallel for
 	for(int i = 0; i < numSourceVertices; ++i)
 	{
 		const size_t vertexOffset = 3*i;
-		const size_t trafoOffset = 12*i;
-		const double x = trafo[trafoOffset+0]*sourceVertices[vertexOffset+0]
-							+ trafo[trafoOffset+3]*sourceVertices[vertexOffset+1]
-							+ trafo[trafoOffset+6]*sourceVertices[vertexOffset+2]
-							+ trafo[trafoOffset+9];
+		const double vx = sourceVertices[vertexOffset+0];
+		const double vy = sourceVertices[vertexOffset+1];
+		const double vz = sourceVertices[vertexOffset+2];
+
+		trafoVertices[vertexOffset+0] = params[0*n+i]*vx + params[3*n+i]*vy + params[6*n+i]*vz + params[9*n+i];
+		trafoVertices[vertexOffset+1] = params[1*n+i]*vx + params[4*n+i]*vy + params[7*n+i]*vz + params[10*n+i];
+		trafoVertices[vertexOffset+2] = params[2*n+i]*vx + params[5*n+i]*vy + params[8*n+i]*vz + params[11*n+i];
+	}
+}
+
+void TemplateFitting::computeTemplateHierarchy(const DataContainer& templateMesh, const size_t maxNumLevels, const size_t minNumVertices
+															, std::vector<DataContainer>& coarseTemplates, std::vector<std::vector<int>>& coarseParents, std::vector<MeshTopology>& topologies)
+{
+	coarseTemplates.clear();
+	coarseParents.clear();
+	topologies.clear();
 
-		const double y = trafo[trafoOffset+1]*sourceVertices[vertexOffset+0]
-							+ trafo[trafoOffset+4]*sourceVertices[vertexOffset+1]
-							+ trafo[trafoOffset+7]*sourceVertices[vertexOffset+2]
-							+ trafo[trafoOffset+10];
+	//Reserve all levels up front, each level is coarsened from the previous one in place
+	coarseTemplates.reserve(maxNumLevels);
+	coarseParents.reserve(maxNumLevels);
+	topologies.reserve(maxNumLevels+1);
 
-		const double z = trafo[trafoOffset+2]*sourceVertices[vertexOffset+0]
-							+ trafo[trafoOffset+5]*sourceVertices[vertexOffset+1]
-							+ trafo[trafoOffset+8]*sourceVertices[vertexOffset+2]
-							+ trafo[trafoOffset+11];
+	topologies.push_back(MeshTopology(templateMesh));
 
-		trafoVertices[vertexOffset+0] = x;
-		trafoVertices[vertexOffset+1] = y;
-		trafoVertices[vertexOffset+2] = z;
+	const DataContainer* pMesh = &templateMesh;
+	for(size_t i = 0; i < maxNumLevels; ++i)
+	{
+		DataContainer coarseMesh;
+		std::vector<int> parents;
+		TemplateFitting::coarsenMesh(*pMesh, topologies.back(), coarseMesh, parents);
+
+		const size_t numCoarseVertices = coarseMesh.getNumVertices();
+		if(numCoarseVertices < minNumVertices || numCoarseVertices == pMesh->getNumVertices())
+		{
+			break;
+		}
+
+		coarseTemplates.push_back(std::move(coarseMesh));
+		coarseParents.push_back(std::move(parents));
+		pMesh = &coarseTemplates.back();
+
+		topologies.push_back(MeshTopology(*pMesh));
 	}
 }
 
-void TemplateFitting::computeEdges(const DataContainer& mesh, std::vector<std::pair<int,int>>& templateEdges)
+void TemplateFitting::coarsenMesh(const DataContainer& mesh, const MeshTopology& topology, DataContainer& coarseMesh, std::vector<int>& parents)
 {
-	const std::vector<std::vector<int>>& triangles = mesh.getVertexIndexList();
-	
-	std::vector<std::set<int>> indices;
-	indices.resize(mesh.getNumVertices());
+	const std::vector<double>& vertices = mesh.getVertexList();
+	const size_t numVertices = mesh.getNumVertices();
+
+	const std::vector<int>& neighborOffsets = topology.getNeighborOffsets();
+	const std::vector<int>& neighbors = topology.getNeighbors();
+
+	parents.clear();
+	parents.resize(numVertices, -1);
 
-	for(size_t i = 0; i < triangles.size(); ++i)
+	std::vector<double> coarseVertices;
+	int numCoarseVertices(0);
+
+	for(size_t i = 0; i < numVertices; ++i)
 	{
-		const int i1 = triangles[i][0];
-		const int i2 = triangles[i][1];
-		const int i3 = triangles[i][2];
-		
-		indices[i1 < i2 ? i1 : i2].insert(i1 < i2 ? i2 : i1);
-		indices[i1 < i3 ? i1 : i3].insert(i1 < i3 ? i3 : i1);
-		indices[i2 < i3 ? i2 : i3].insert(i2 < i3 ? i3 : i2);
+		if(parents[i] >= 0)
+		{
+			continue;
+		}
+
+		parents[i] = numCoarseVertices;
+		for(int k = neighborOffsets[i]; k < neighborOffsets[i+1]; ++k)
+		{
+			const int neighbor = neighbors[k];
+			if(parents[neighbor] < 0)
+			{
+				parents[neighbor] = numCoarseVertices;
+			}
+		}
+
+		const size_t vertexOffset = 3*i;
+		coarseVertices.push_back(vertices[vertexOffset+0]);
+		coarseVertices.push_back(vertices[vertexOffset+1]);
+		coarseVertices.push_back(vertices[vertexOffset+2]);
+
+		++numCoarseVertices;
+	}
+
+	const std::vector<int>& triangles = mesh.getTriangleList();
+	const size_t numTriangles = mesh.getNumFaces();
+
+	std::vector<int> coarseTriangles;
+	std::set<std::vector<int>> coarseTriangleKeys;
+
+	for(size_t i = 0; i < numTriangles; ++i)
+	{
+		std::vector<int> coarseTriangle(3);
+		for(size_t j = 0; j < 3; ++j)
+		{
+			coarseTriangle[j] = parents[triangles[3*i+j]];
+		}
+
+		//Triangles with two vertices in the same cluster collapse, of triangles with the same clusters only the first one is kept
+		std::vector<int> triangleKey(coarseTriangle);
+		std::sort(triangleKey.begin(), triangleKey.end());
+		if(std::adjacent_find(triangleKey.begin(), triangleKey.end()) != triangleKey.end() || !coarseTriangleKeys.insert(triangleKey).second)
+		{
+			continue;
+		}
+
+		coarseTriangles.insert(coarseTriangles.end(), coarseTriangle.begin(), coarseTriangle.end());
+	}
+
+	coarseMesh.clear();
+	coarseMesh.setVertexList(std::move(coarseVertices));
+	coarseMesh.setTriangleList(std::move(coarseTriangles));
+}
+
+void TemplateFitting::computeIterationLevels(const size_t numCoarseLevels, const size_t numIter, const size_t numFullResolutionIter, std::vector<size_t>& iterationLevels)
+{
+	iterationLevels.clear();
+	iterationLevels.resize(numIter, 0);
+
+	if(numCoarseLevels == 0 || numIter == 0)
+	{
+		return;
 	}
 
-	for(size_t i = 0; i < indices.size(); ++i)
+	const size_t numCoarseIter = numIter-std::max<size_t>(std::min(numFullResolutionIter, numIter), 1);
+
+	//The coarsest level additionally gets the remaining iterations
+	size_t iIter(0);
+	for(size_t level = numCoarseLevels; level > 0; --level)
+	{
+		const size_t numLevelIter = numCoarseIter/numCoarseLevels + (level == numCoarseLevels ? numCoarseIter%numCoarseLevels : 0);
+		for(size_t i = 0; i < numLevelIter; ++i)
+		{
+			iterationLevels[iIter++] = level;
+		}
+	}
+}
+
+void TemplateFitting::prolongateTransformation(const std::vector<int>& parents, const vnl_vector<double>& coarseTrafo, vnl_vector<double>& trafo)
+{
+	const size_t numVertices = parents.size();
+	const size_t numCoarseVertices = coarseTrafo.size()/12;
+
+	trafo.set_size(12*numVertices);
+
+	//Parameter p of vertex i is stored at p*numVertices+i
+	const double* coarseParams = coarseTrafo.data_block();
+	double* params = trafo.data_block();
+
+#pragma omp parallel for
+	for(int i = 0; i < numVertices; ++i)
 	{
-		const std::set<int>& currSet = indices[i];
-		std::set<int>::const_iterator currIter = currSet.begin();
-		const std::set<int>::const_iterator endIter = currSet.end();
-		for(; currIter != endIter; ++currIter)
+		const size_t parent = parents[i];
+		for(size_t p = 0; p < 12; ++p)
 		{
-			templateEdges.push_back(std::make_pair(i,*currIter));
+			params[p*numVertices+i] = coarseParams[p*numCoarseVertices+parent];
 		}
 	}
 }
\ No newline at end of file
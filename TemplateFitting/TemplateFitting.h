@@ -15,7 +15,13 @@
 #define TEMPLATEFITTING_H
 
 #include "DataContainer.h"
+#include "Definitions.h"
+#include "FitOptions.h"
 #include "KDTree3.h"
+#include "MeshTopology.h"
+#include "TargetData.h"
+#include "TemplateData.h"
+#include "TriangleBVH.h"
 
 #include <vnl/vnl_vector.h>
 
@@ -24,17 +30,96 @@
 class TemplateFitting
 {
 public:
-	static void fitTemplate(const DataContainer& templateMesh, const DataContainer& targetMesh, DataContainer& outMesh); 
+	//! Result statistics of a fitting
+	struct FitStatistics
+	{
+		//Number of performed iterations and whether they stopped on convergence
+		size_t numIterations;
+		bool bConverged;
 
+		//Fraction of valid correspondences in the last iteration
+		double validFraction;
+
+		//Mean distance of the fitted template vertices to the target
+		double meanDistance;
+
+		//Run time of the fitting in ms
+		double time;
+	};
+
+	//! Fits the template to the target.
+	//! \param options				run-time parameters of the fitting
+	static void fitTemplate(const DataContainer& templateMesh, const DataContainer& targetMesh, DataContainer& outMesh, const FitOptions& options = FitOptions()); 
+
+	//! Fits the template to a target with pre-computed target data, fittings to the same target data can run concurrently.
+	//! \param options				run-time parameters of the fitting, options.precision selects the storage precision of the fitting energy
+	//! \param pStatistics			optional output of the fitting statistics
+	static void fitTemplate(const DataContainer& templateMesh, const TargetData& targetData, const FitOptions& options, DataContainer& outMesh, FitStatistics* pStatistics = NULL); 
+
+	//! Fits the template to a target with pre-computed template and target data, fittings sharing the same template data can run concurrently.
+	//! \param templateVertices		vertices of the template mesh of templateData, e.g. rigidly aligned to the target
+	static void fitTemplate(const TemplateData& templateData, const std::vector<double>& templateVertices, const TargetData& targetData, const FitOptions& options, DataContainer& outMesh, FitStatistics* pStatistics = NULL); 
+
+	//! Computes up to maxNumLevels coarser versions of the template, coarsening stops before a level gets less than minNumVertices vertices.
+	//! coarseParents[l] maps each vertex of level l to its cluster vertex of level l+1, where level 0 is the template and level l+1 is coarseTemplates[l].
+	//! topologies[l] is the topology of level l, including the vertex neighbors the coarsening is based on.
+	static void computeTemplateHierarchy(const DataContainer& templateMesh, const size_t maxNumLevels, const size_t minNumVertices
+													, std::vector<DataContainer>& coarseTemplates, std::vector<std::vector<int>>& coarseParents, std::vector<MeshTopology>& topologies);
 
 private:
 
+	//! Fitting with the energy data stored with the scalar type Scalar, float or double
+	template<typename Scalar>
+	static void fitTemplate(const TemplateData& templateData, const std::vector<double>& templateVertices, const TargetData& targetData, const FitOptions& options, DataContainer& outMesh, FitStatistics* pStatistics);
+
+	//! Computes the correspondences of all source vertices with one batched kd tree query followed by one parallel validation pass.
+	//! Writes per source vertex the nearest target vertex index, the squared distance to it, the projection into its tangent plane and the validity flag.
 	static void computeNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& sourceNormals, const std::vector<double>& targetVertices, const std::vector<double>& targetNormals, const KDTree3& targetKDTree
-													, const double maxDist, const double maxAngle, std::vector<double>& nearestNeighbors, std::vector<bool>& validValues);
+													, const double maxDist, const double maxAngle, std::vector<int>& nearestNeighborIndices, std::vector<double>& nearestNeighborSqrDists
+													, std::vector<double>& nearestNeighbors, std::vector<char>& validValues);
+
+	//! Computes the correspondences like computeNearestNeighbors, but reuses the nearest neighbors of the previous iteration passed in nearestNeighborIndices and nearestNeighborSqrDists.
+	//! A vertex whose displacement since prevSourceVertices is at most maxDisplacementRatio times its previous nearest neighbor distance walks greedily 
+	//! over the target vertex adjacency from its previous nearest neighbor to the closest neighbor until no neighbor is closer, all other vertices are queried in the kd tree.
+	//! Without previous nearest neighbors of the same source vertices, all vertices are queried.
+	//! \return number of kd tree queries
+	static size_t computeCoherentNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& prevSourceVertices, const std::vector<double>& sourceNormals
+																, const std::vector<double>& targetVertices, const std::vector<double>& targetNormals, const std::vector<int>& targetNeighborOffsets, const std::vector<int>& targetNeighbors
+																, const KDTree3& targetKDTree, const double maxDist, const double maxAngle, const double maxDisplacementRatio
+																, std::vector<int>& nearestNeighborIndices, std::vector<double>& nearestNeighborSqrDists, std::vector<double>& nearestNeighbors, std::vector<char>& validValues);
+
+	//! Validates the nearest target vertices by distance and normal angle and projects the source vertices of the valid ones into the tangent plane of their nearest neighbor
+	static void validateNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& sourceNormals, const std::vector<double>& targetVertices, const std::vector<double>& targetNormals
+													, const double maxDist, const double maxAngle, const std::vector<int>& nearestNeighborIndices, const std::vector<double>& nearestNeighborSqrDists
+													, std::vector<double>& nearestNeighbors, std::vector<char>& validValues);
+
+	//! Computes the correspondences of all source vertices as closest points on the target surface in one parallel pass.
+	//! Writes per source vertex the closest target face index, the squared distance to the surface, the closest surface point and the validity flag.
+	static void computeNearestNeighbors(const std::vector<double>& sourceVertices, const std::vector<double>& sourceNormals, const TriangleBVH& targetBVH
+													, const double maxDist, const double maxAngle, std::vector<int>& nearestFaceIndices, std::vector<double>& nearestSqrDists
+													, std::vector<double>& nearestNeighbors, std::vector<char>& validValues);
+
+	//! Fraction of source vertices whose correspondence index or validity differs between two correspondence sets
+	static double computeCorrespondenceChange(const std::vector<int>& prevIndices, const std::vector<char>& prevValidValues, const std::vector<int>& indices, const std::vector<char>& validValues);
+
+	//! Maximum Euclidean distance between corresponding vertices of two vertex lists
+	static double computeMaxDisplacement(const std::vector<double>& vertices1, const std::vector<double>& vertices2);
 
 	static void updateTransformation(const std::vector<double>& sourceVertices, const vnl_vector<double>& trafo, std::vector<double>& trafoVertices);
 
-	static void computeEdges(const DataContainer& mesh, std::vector<std::pair<int,int>>& templateEdges);
+	//! Clusters every vertex with its not yet clustered 1-ring neighbors. The first vertex of a cluster becomes its coarse vertex, 
+	//! faces are mapped to the clusters and collapsed or duplicate faces are removed.
+	static void coarsenMesh(const DataContainer& mesh, const MeshTopology& topology, DataContainer& coarseMesh, std::vector<int>& parents);
+
+	//! Assigns the template level to each iteration. The last numFullResolutionIter iterations (at least one) use the template itself,
+	//! the remaining iterations are distributed over the coarse levels, starting with the coarsest.
+	static void computeIterationLevels(const size_t numCoarseLevels, const size_t numIter, const size_t numFullResolutionIter, std::vector<size_t>& iterationLevels);
+
+	//! Transfers the affine transformations of a coarse level to the next finer level, every vertex takes the transformation of its cluster vertex
+	static void prolongateTransformation(const std::vector<int>& parents, const vnl_vector<double>& coarseTrafo, vnl_vector<double>& trafo);
+
+	//! Mean distance of the vertices to the target, to the nearest target vertex or to the target surface
+	static double computeMeanTargetDistance(const std::vector<double>& vertices, const TargetData& targetData);
 };
 
 #endif
\ No newline at end of file
@@ -12,211 +12,211 @@
 /*************************************************************************************************************************/
 
 #include "TemplateFittingCostFunction.h"
-#include "VectorNX.h"
 
+#include <algorithm>
 #include <iostream>
 
 const double math_eps = 1.0e-6;
 
-TemplateFittingCostFunction::TemplateFittingCostFunction(const std::vector<double>& templateVertices, const std::vector<std::pair<int,int>>& templateEdges, const std::vector<double>& targetVertices, const std::vector<bool>& validTargetVertices
+namespace
+{
+	//Number of consecutive vertices processed by one SIMD loop
+	const size_t BLOCK_SIZE = 256;
+}
+
+template<typename Scalar>
+TemplateFittingCostFunction<Scalar>::TemplateFittingCostFunction(const std::vector<double>& templateVertices, const std::vector<int>& templateNeighborOffsets, const std::vector<int>& templateNeighbors, const std::vector<double>& targetVertices, const std::vector<char>& validTargetVertices
 																			, const double nearestNeighborWeight, const double regularizationWeight, const double rigidWeight)
 : vnl_cost_function(4*templateVertices.size())
-, m_templateVertices(templateVertices)
-, m_templateEdges(templateEdges)
-, m_targetVertices(targetVertices)
-, m_validTargetVertices(validTargetVertices)
 , m_numTemplateVertices(templateVertices.size()/3)
+, m_templateNeighborOffsets(templateNeighborOffsets)
+, m_templateNeighbors(templateNeighbors)
+, m_numEvaluations(0)
 , m_nearestNeighborWeight(nearestNeighborWeight)
 , m_regularizationWeight(regularizationWeight)
 , m_rigidWeight(rigidWeight)
 {
-	m_trafoTemplateVertices.resize(templateVertices.size(), 0.0);
-}
+	m_templateX.resize(m_numTemplateVertices);
+	m_templateY.resize(m_numTemplateVertices);
+	m_templateZ.resize(m_numTemplateVertices);
 
-TemplateFittingCostFunction::~TemplateFittingCostFunction()
-{
+	m_targetX.resize(m_numTemplateVertices);
+	m_targetY.resize(m_numTemplateVertices);
+	m_targetZ.resize(m_numTemplateVertices);
 
-}
+	m_nearestNeighborWeights.resize(m_numTemplateVertices);
 
-void TemplateFittingCostFunction::compute(const vnl_vector<double>& x, double* f, vnl_vector<double>* g)
-{
-	//Update current transformed points
-	updateTransformation(x);
+#pragma omp parallel for
+	for(int i = 0; i < m_numTemplateVertices; ++i)
+	{
+		const size_t vertexOffset = 3*i;
+		m_templateX[i] = static_cast<Scalar>(templateVertices[vertexOffset+0]);
+		m_templateY[i] = static_cast<Scalar>(templateVertices[vertexOffset+1]);
+		m_templateZ[i] = static_cast<Scalar>(templateVertices[vertexOffset+2]);
 
-	//Initialize function value and gradient
-	init(f, g);
+		m_targetX[i] = static_cast<Scalar>(targetVertices[vertexOffset+0]);
+		m_targetY[i] = static_cast<Scalar>(targetVertices[vertexOffset+1]);
+		m_targetZ[i] = static_cast<Scalar>(targetVertices[vertexOffset+2]);
 
-	//Compute energy and gradient
-	addNearestNeighborEnergy(f, g);
-	addRegularizationEnergy(x, f, g);
-	addRigidEnergy(x, f, g);
+		m_nearestNeighborWeights[i] = static_cast<Scalar>(validTargetVertices[i] && nearestNeighborWeight >= math_eps ? nearestNeighborWeight : 0.0);
+	}
 }
 
-void TemplateFittingCostFunction::addNearestNeighborEnergy(double* f, vnl_vector<double>* g)
+template<typename Scalar>
+TemplateFittingCostFunction<Scalar>::~TemplateFittingCostFunction()
 {
-	if(m_nearestNeighborWeight < math_eps)
-	{
-		return;
-	}
 
-	std::vector<double> functionValues;
-	functionValues.resize(m_numTemplateVertices, 0.0);
+}
 
-#pragma omp parallel for
-	for(int i = 0; i < m_numTemplateVertices; ++i)
-	{
-		if(m_validTargetVertices[i])
-		{
-			const size_t vertexOffset = 3*i;
-			const size_t trafoOffset = 12*i;
+template<typename Scalar>
+void TemplateFittingCostFunction<Scalar>::compute(const vnl_vector<double>& x, double* f, vnl_vector<double>* g)
+{
+	++m_numEvaluations;
 
-			const double tmpDX = m_trafoTemplateVertices[vertexOffset+0]-m_targetVertices[vertexOffset+0];
-			const double tmpDY = m_trafoTemplateVertices[vertexOffset+1]-m_targetVertices[vertexOffset+1];
-			const double tmpDZ = m_trafoTemplateVertices[vertexOffset+2]-m_targetVertices[vertexOffset+2];
-			functionValues[i] = m_nearestNeighborWeight*(std::pow(tmpDX,2)+std::pow(tmpDY,2)+std::pow(tmpDZ,2));
+	const size_t numVertices = m_numTemplateVertices;
+	const int numBlocks = static_cast<int>((numVertices+BLOCK_SIZE-1)/BLOCK_SIZE);
 
-			(*g)[trafoOffset+0] += 2.0*m_nearestNeighborWeight*(tmpDX)*(m_templateVertices[vertexOffset+0]); //t_00
-			(*g)[trafoOffset+1] += 2.0*m_nearestNeighborWeight*(tmpDY)*(m_templateVertices[vertexOffset+0]); //t_10
-			(*g)[trafoOffset+2] += 2.0*m_nearestNeighborWeight*(tmpDZ)*(m_templateVertices[vertexOffset+0]); //t_20
+	const double* params = x.data_block();
+	double* grad = g->data_block();
 
-			(*g)[trafoOffset+3] += 2.0*m_nearestNeighborWeight*(tmpDX)*(m_templateVertices[vertexOffset+1]); //t_01
-			(*g)[trafoOffset+4] += 2.0*m_nearestNeighborWeight*(tmpDY)*(m_templateVertices[vertexOffset+1]); //t_11
-			(*g)[trafoOffset+5] += 2.0*m_nearestNeighborWeight*(tmpDZ)*(m_templateVertices[vertexOffset+1]); //t_21
+	const bool bRegularization = m_regularizationWeight >= math_eps;
 
-			(*g)[trafoOffset+6] += 2.0*m_nearestNeighborWeight*(tmpDX)*(m_templateVertices[vertexOffset+2]); //t_02
-			(*g)[trafoOffset+7] += 2.0*m_nearestNeighborWeight*(tmpDY)*(m_templateVertices[vertexOffset+2]); //t_12
-			(*g)[trafoOffset+8] += 2.0*m_nearestNeighborWeight*(tmpDZ)*(m_templateVertices[vertexOffset+2]); //t_22
+	//Every block of vertices is transformed and evaluated in a single pass, the gradient of a vertex is only written by the thread owning its block
+	double energy(0.0);
 
-			(*g)[trafoOffset+9] += 2.0*m_nearestNeighborWeight*(tmpDX); //t_03
-			(*g)[trafoOffset+10] += 2.0*m_nearestNeighborWeight*(tmpDY); //t_13
-			(*g)[trafoOffset+11] += 2.0*m_nearestNeighborWeight*(tmpDZ); //t_23
+#pragma omp parallel for reduction(+:energy)
+	for(int iBlock = 0; iBlock < numBlocks; ++iBlock)
+	{
+		const size_t begin = iBlock*BLOCK_SIZE;
+		const size_t end = std::min(begin+BLOCK_SIZE, numVertices);
+
+		double blockEnergy = computeVertexEnergy(params, begin, end, grad);
+		if(bRegularization)
+		{
+			blockEnergy += addRegularizationEnergy(params, begin, end, grad);
 		}
-	}
 
-	for(size_t i = 0; i < m_numTemplateVertices; ++i)
-	{
-		(*f) += functionValues[i];
+		energy += blockEnergy;
 	}
+
+	*f = energy;
 }
 
-void TemplateFittingCostFunction::addRegularizationEnergy(const vnl_vector<double>& trafo, double* f, vnl_vector<double>* g)
+template<typename Scalar>
+double TemplateFittingCostFunction<Scalar>::computeVertexEnergy(const double* params, const size_t begin, const size_t end, double* grad) const
 {
-	if(m_regularizationWeight < math_eps)
-	{
-		return;
-	}
+	const size_t numVertices = m_numTemplateVertices;
 
-	const size_t numEdges = m_templateEdges.size();
+	const Scalar* templateX = &m_templateX[0];
+	const Scalar* templateY = &m_templateY[0];
+	const Scalar* templateZ = &m_templateZ[0];
+	const Scalar* targetX = &m_targetX[0];
+	const Scalar* targetY = &m_targetY[0];
+	const Scalar* targetZ = &m_targetZ[0];
+	const Scalar* weights = &m_nearestNeighborWeights[0];
 
-	for(int i = 0; i < numEdges; ++i)
-	{
-		const int id1 = m_templateEdges[i].first;
-		const int id2 = m_templateEdges[i].second;
-
-		const int offset1 = id1*12;
-		const int offset2 = id2*12;
+	const double rigidWeight = m_rigidWeight >= math_eps ? m_rigidWeight : 0.0;
 
-		for(int j = 0; j < 12; ++j)
-		{
-			const double diff = trafo[offset1+j]-trafo[offset2+j];
+	double energy(0.0);
 
-			(*f) += m_regularizationWeight*std::pow(diff, 2);
-			
-			(*g)[offset1+j] += 2.0*m_regularizationWeight*diff;
-			(*g)[offset2+j] -= 2.0*m_regularizationWeight*diff;
-		}
+#pragma omp simd reduction(+:energy)
+	for(size_t i = begin; i < end; ++i)
+	{
+		const double a00 = params[0*numVertices+i];
+		const double a10 = params[1*numVertices+i];
+		const double a20 = params[2*numVertices+i];
+		const double a01 = params[3*numVertices+i];
+		const double a11 = params[4*numVertices+i];
+		const double a21 = params[5*numVertices+i];
+		const double a02 = params[6*numVertices+i];
+		const double a12 = params[7*numVertices+i];
+		const double a22 = params[8*numVertices+i];
+
+		//Stored data is widened once, the remaining computation is double
+		const double vx = templateX[i];
+		const double vy = templateY[i];
+		const double vz = templateZ[i];
+
+		//Nearest neighbor energy of the transformed vertex, invalid correspondences have zero weight
+		const double w = weights[i];
+		const double dx = a00*vx + a01*vy + a02*vz + params[9*numVertices+i] - targetX[i];
+		const double dy = a10*vx + a11*vy + a12*vz + params[10*numVertices+i] - targetY[i];
+		const double dz = a20*vx + a21*vy + a22*vz + params[11*numVertices+i] - targetZ[i];
+
+		const double gx = 2.0*w*dx;
+		const double gy = 2.0*w*dy;
+		const double gz = 2.0*w*dz;
+
+		//Rigid energy of the columns of the linear part
+		const double t1t2 = a00*a01+a10*a11+a20*a21;
+		const double t1t3 = a00*a02+a10*a12+a20*a22;
+		const double t2t3 = a01*a02+a11*a12+a21*a22;
+
+		const double d1 = 1.0-(a00*a00+a10*a10+a20*a20);
+		const double d2 = 1.0-(a01*a01+a11*a11+a21*a21);
+		const double d3 = 1.0-(a02*a02+a12*a12+a22*a22);
+
+		energy += w*(dx*dx+dy*dy+dz*dz) + rigidWeight*(t1t2*t1t2 + t1t3*t1t3 + t2t3*t2t3 + d1*d1 + d2*d2 + d3*d3);
+
+		grad[0*numVertices+i] = gx*vx + rigidWeight*(2.0*(a01*t1t2 + a02*t1t3) - 4.0*a00*d1); //t_00
+		grad[1*numVertices+i] = gy*vx + rigidWeight*(2.0*(a11*t1t2 + a12*t1t3) - 4.0*a10*d1); //t_10
+		grad[2*numVertices+i] = gz*vx + rigidWeight*(2.0*(a21*t1t2 + a22*t1t3) - 4.0*a20*d1); //t_20
+
+		grad[3*numVertices+i] = gx*vy + rigidWeight*(2.0*(a00*t1t2 + a02*t2t3) - 4.0*a01*d2); //t_01
+		grad[4*numVertices+i] = gy*vy + rigidWeight*(2.0*(a10*t1t2 + a12*t2t3) - 4.0*a11*d2); //t_11
+		grad[5*numVertices+i] = gz*vy + rigidWeight*(2.0*(a20*t1t2 + a22*t2t3) - 4.0*a21*d2); //t_21
+
+		grad[6*numVertices+i] = gx*vz + rigidWeight*(2.0*(a00*t1t3 + a01*t2t3) - 4.0*a02*d3); //t_02
+		grad[7*numVertices+i] = gy*vz + rigidWeight*(2.0*(a10*t1t3 + a11*t2t3) - 4.0*a12*d3); //t_12
+		grad[8*numVertices+i] = gz*vz + rigidWeight*(2.0*(a20*t1t3 + a21*t2t3) - 4.0*a22*d3); //t_22
+
+		grad[9*numVertices+i] = gx; //t_03
+		grad[10*numVertices+i] = gy; //t_13
+		grad[11*numVertices+i] = gz; //t_23
 	}
+
+	return energy;
 }
 
-void TemplateFittingCostFunction::addRigidEnergy(const vnl_vector<double>& trafo, double* f, vnl_vector<double>* g)
+template<typename Scalar>
+double TemplateFittingCostFunction<Scalar>::addRegularizationEnergy(const double* params, const size_t begin, const size_t end, double* grad) const
 {
-	if(m_rigidWeight < math_eps)
-	{
-		return;
-	}
+	const size_t numVertices = m_numTemplateVertices;
 
-	std::vector<double> functionValues;
-	functionValues.resize(m_numTemplateVertices, 0.0);
+	//Sum over all edges of |X_i-X_j|^2 = tr(X^T*L*X) with the graph Laplacian L, the gradient is 2*L*X.
+	//Each vertex gathers from its neighbors, such that only the gradient of the own vertices is written.
+	double energy(0.0);
 
-#pragma omp parallel for
-	for(int i = 0; i < m_numTemplateVertices; ++i)
+	for(size_t i = begin; i < end; ++i)
 	{
-		const size_t trafoOffset = 12*i;
-
-		const Vec3d t1(trafo[trafoOffset+0], trafo[trafoOffset+1], trafo[trafoOffset+2]);
-		const Vec3d t2(trafo[trafoOffset+3], trafo[trafoOffset+4], trafo[trafoOffset+5]);
-		const Vec3d t3(trafo[trafoOffset+6], trafo[trafoOffset+7], trafo[trafoOffset+8]);
-
-		const double t1t2 = t1.dotProduct(t2);
-		const double t1t3 = t1.dotProduct(t3);
-		const double t2t3 = t2.dotProduct(t3);
+		const int beginNeighbor = m_templateNeighborOffsets[i];
+		const int endNeighbor = m_templateNeighborOffsets[i+1];
+		const double degree = static_cast<double>(endNeighbor-beginNeighbor);
 
-		const double t1Length = t1.length();
-		const double t2Length = t2.length();
-		const double t3Length = t3.length();
-
-		const Vec3d grad1 = t2*t1t2*2.0 + t3*t1t3*2.0 - t1*4.0*(1-std::pow(t1Length,2));
-		const Vec3d grad2 = t1*t1t2*2.0 + t3*t2t3*2.0 - t2*4.0*(1-std::pow(t2Length,2));
-		const Vec3d grad3 = t1*t1t3*2.0 + t2*t2t3*2.0 - t3*4.0*(1-std::pow(t3Length,2));
-
-		functionValues[i] =  m_rigidWeight*(std::pow(t1t2, 2) + std::pow(t1t3, 2) + std::pow(t2t3, 2) + std::pow(1-std::pow(t1Length, 2),2) + std::pow(1-std::pow(t2Length, 2),2) + std::pow(1-std::pow(t3Length, 2),2));
-
-		(*g)[trafoOffset+0] += m_rigidWeight*grad1[0];
-		(*g)[trafoOffset+1] += m_rigidWeight*grad1[1];
-		(*g)[trafoOffset+2] += m_rigidWeight*grad1[2];
-	
-		(*g)[trafoOffset+3] += m_rigidWeight*grad2[0];
-		(*g)[trafoOffset+4] += m_rigidWeight*grad2[1];
-		(*g)[trafoOffset+5] += m_rigidWeight*grad2[2];
+		double laplacian[12];
+		for(size_t j = 0; j < 12; ++j)
+		{
+			laplacian[j] = degree*params[j*numVertices+i];
+		}
 
-		(*g)[trafoOffset+6] += m_rigidWeight*grad3[0];
-		(*g)[trafoOffset+7] += m_rigidWeight*grad3[1];
-		(*g)[trafoOffset+8] += m_rigidWeight*grad3[2];
-	}
+		for(int k = beginNeighbor; k < endNeighbor; ++k)
+		{
+			const int neighbor = m_templateNeighbors[k];
+			for(size_t j = 0; j < 12; ++j)
+			{
+				laplacian[j] -= params[j*numVertices+neighbor];
+			}
+		}
 
-	for(size_t i = 0; i < m_numTemplateVertices; ++i)
-	{
-		(*f) += functionValues[i];
+		for(size_t j = 0; j < 12; ++j)
+		{
+			energy += params[j*numVertices+i]*laplacian[j];
+			grad[j*numVertices+i] += 2.0*m_regularizationWeight*laplacian[j];
+		}
 	}
-}
 
-void TemplateFittingCostFunction::updateTransformation(const vnl_vector<double>& trafo)
-{
-#pragma omp parallel for
-	for(int i = 0; i < m_numTemplateVertices; ++i)
-	{
-		const size_t vertexOffset = 3*i;
-		const size_t trafoOffset = 12*i;
-		const double x = trafo[trafoOffset+0]*m_templateVertices[vertexOffset+0]
-							+ trafo[trafoOffset+3]*m_templateVertices[vertexOffset+1]
-							+ trafo[trafoOffset+6]*m_templateVertices[vertexOffset+2]
-							+ trafo[trafoOffset+9];
-
-		const double y = trafo[trafoOffset+1]*m_templateVertices[vertexOffset+0]
-							+ trafo[trafoOffset+4]*m_templateVertices[vertexOffset+1]
-							+ trafo[trafoOffset+7]*m_templateVertices[vertexOffset+2]
-							+ trafo[trafoOffset+10];
-
-		const double z = trafo[trafoOffset+2]*m_templateVertices[vertexOffset+0]
-							+ trafo[trafoOffset+5]*m_templateVertices[vertexOffset+1]
-							+ trafo[trafoOffset+8]*m_templateVertices[vertexOffset+2]
-							+ trafo[trafoOffset+11];
-
-		m_trafoTemplateVertices[vertexOffset+0] = x;
-		m_trafoTemplateVertices[vertexOffset+1] = y;
-		m_trafoTemplateVertices[vertexOffset+2] = z;
-	}
+	return m_regularizationWeight*energy;
 }
 
-void TemplateFittingCostFunction::init(double* f, vnl_vector<double>* g)
-{
-	*f = 0.0;
-
-	const size_t dim = 12*m_numTemplateVertices;
-		
-#pragma omp parallel for
-	for(int i = 0; i < dim; ++i)
-	{
-		(*g)[i] = 0.0;
-	}
-}
\ No newline at end of file
+template class TemplateFittingCostFunction<float>;
+template class TemplateFittingCostFunction<double>;
\ No newline at end of file
@@ -19,36 +19,58 @@
 
 #include <vector>
 
+//! Energy of the per-vertex affine transformations of the template.
+//! The 12 parameters of each vertex form a column-major 3x4 matrix [A|t]. The parameter vector stores them as structure of arrays, 
+//! parameter p of vertex i is at position p*numVertices+i, such that all kernels process consecutive vertices with contiguous SIMD loads.
+//! The per-vertex template, correspondence and weight data is stored with the scalar type Scalar, instantiated for float and double. 
+//! Parameters, energy and gradient are always double, with float storage all arithmetic is still carried out in double precision.
+template<typename Scalar>
 class TemplateFittingCostFunction : public vnl_cost_function
 {
 public:
 
-	TemplateFittingCostFunction(const std::vector<double>& templateVertices, const std::vector<std::pair<int,int>>& templateEdges, const std::vector<double>& targetVertices, const std::vector<bool>& validTargetVertices
+	//! \param templateVertices			3d template vertices
+	//! \param templateNeighborOffsets	start of the neighbors of each template vertex within templateNeighbors, numVertices+1 values
+	//! \param templateNeighbors			neighbors of all template vertices, the regularization energy is computed from this graph Laplacian
+	TemplateFittingCostFunction(const std::vector<double>& templateVertices, const std::vector<int>& templateNeighborOffsets, const std::vector<int>& templateNeighbors, const std::vector<double>& targetVertices, const std::vector<char>& validTargetVertices
 										, const double nearestNeighborWeight, const double regularizationWeight, const double rigidWeight);
 
 	~TemplateFittingCostFunction();
 
 	virtual void compute(const vnl_vector<double>& x, double* f, vnl_vector<double>* g);
 
+	//! Number of calls of compute since construction
+	size_t getNumEvaluations() const { return m_numEvaluations; }
+
+	//! Position of parameter p of vertex i within the parameter vector
+	static size_t getParameterIndex(const size_t numVertices, const size_t i, const size_t p) { return p*numVertices+i; }
+
 private:
 
-	void addNearestNeighborEnergy(double* f, vnl_vector<double>* g);
+	//! Transformation, nearest neighbor and rigid energy of the vertices begin..end-1 in one pass.
+	//! Overwrites the gradient entries of these vertices and returns their energy.
+	double computeVertexEnergy(const double* params, const size_t begin, const size_t end, double* grad) const;
 
-	void addRegularizationEnergy(const vnl_vector<double>& trafo, double* f, vnl_vector<double>* g);
+	//! Adds the regularization gradient of the vertices begin..end-1 and returns their share of the regularization energy
+	double addRegularizationEnergy(const double* params, const size_t begin, const size_t end, double* grad) const;
 
-	void addRigidEnergy(const vnl_vector<double>& trafo, double* f, vnl_vector<double>* g);
+	size_t m_numTemplateVertices;
+	const std::vector<int>& m_templateNeighborOffsets;
+	const std::vector<int>& m_templateNeighbors;
 
-	void updateTransformation(const vnl_vector<double>& trafo);
+	//Template vertices and correspondences as separate coordinate arrays
+	std::vector<Scalar> m_templateX;
+	std::vector<Scalar> m_templateY;
+	std::vector<Scalar> m_templateZ;
 
-	void init(double* f, vnl_vector<double>* g);
+	std::vector<Scalar> m_targetX;
+	std::vector<Scalar> m_targetY;
+	std::vector<Scalar> m_targetZ;
 
-	size_t m_numTemplateVertices;
-	const std::vector<double>& m_templateVertices;
-	const std::vector<std::pair<int,int>>& m_templateEdges;	
-	const std::vector<double>& m_targetVertices;
-	const std::vector<bool>& m_validTargetVertices;
+	//Nearest neighbor weight of each vertex, zero for invalid correspondences
+	std::vector<Scalar> m_nearestNeighborWeights;
 
-	std::vector<double> m_trafoTemplateVertices;
+	size_t m_numEvaluations;
 
 	const double m_nearestNeighborWeight;
 	const double m_regularizationWeight;
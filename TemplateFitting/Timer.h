@@ -0,0 +1,43 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <chrono>
+
+//! Wall clock timer, started on construction
+class Timer
+{
+public:
+	Timer()
+	: m_start(std::chrono::steady_clock::now())
+	{
+
+	}
+
+	void restart()
+	{
+		m_start = std::chrono::steady_clock::now();
+	}
+
+	double elapsedMilliseconds() const
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()-m_start).count();
+	}
+
+private:
+	std::chrono::steady_clock::time_point m_start;
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,378 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+namespace
+{
+	//Median splits limit the depth to log2 of the number of triangles
+	const size_t MAX_STACK_SIZE = 64;
+
+	struct CentroidLess
+	{
+		CentroidLess(const std::vector<double>& centroids, const size_t dim)
+		: m_centroids(centroids), m_dim(dim)
+		{}
+
+		bool operator()(const int i1, const int i2) const
+		{
+			return m_centroids[3*i1+m_dim] < m_centroids[3*i2+m_dim];
+		}
+
+		const std::vector<double>& m_centroids;
+		const size_t m_dim;
+	};
+
+	struct BuildEntry
+	{
+		int parent;
+		int begin;
+		int end;
+	};
+
+	double getSqrBoxDistance(const double* point, const double* bboxMin, const double* bboxMax)
+	{
+		double sqrDist(0.0);
+		for(size_t i = 0; i < 3; ++i)
+		{
+			const double diff = std::max(std::max(bboxMin[i]-point[i], point[i]-bboxMax[i]), 0.0);
+			sqrDist += diff*diff;
+		}
+
+		return sqrDist;
+	}
+
+	double dot(const double* v1, const double* v2)
+	{
+		return v1[0]*v2[0]+v1[1]*v2[1]+v1[2]*v2[2];
+	}
+
+	//Closest point on triangle abc, from Ericson - Real-Time Collision Detection, Section 5.1.5.
+	//Returns the barycentric coordinates w.r.t. a, b and c.
+	void getClosestPointOnTriangle(const double* p, const double* a, const double* b, const double* c, double* barycentric)
+	{
+		const double ab[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+		const double ac[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+		const double ap[3] = {p[0]-a[0], p[1]-a[1], p[2]-a[2]};
+
+		const double d1 = dot(ab, ap);
+		const double d2 = dot(ac, ap);
+		if(d1 <= 0.0 && d2 <= 0.0)
+		{
+			barycentric[0] = 1.0; barycentric[1] = 0.0; barycentric[2] = 0.0;
+			return;
+		}
+
+		const double bp[3] = {p[0]-b[0], p[1]-b[1], p[2]-b[2]};
+		const double d3 = dot(ab, bp);
+		const double d4 = dot(ac, bp);
+		if(d3 >= 0.0 && d4 <= d3)
+		{
+			barycentric[0] = 0.0; barycentric[1] = 1.0; barycentric[2] = 0.0;
+			return;
+		}
+
+		const double vc = d1*d4-d3*d2;
+		if(vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+		{
+			const double v = d1/(d1-d3);
+			barycentric[0] = 1.0-v; barycentric[1] = v; barycentric[2] = 0.0;
+			return;
+		}
+
+		const double cp[3] = {p[0]-c[0], p[1]-c[1], p[2]-c[2]};
+		const double d5 = dot(ab, cp);
+		const double d6 = dot(ac, cp);
+		if(d6 >= 0.0 && d5 <= d6)
+		{
+			barycentric[0] = 0.0; barycentric[1] = 0.0; barycentric[2] = 1.0;
+			return;
+		}
+
+		const double vb = d5*d2-d1*d6;
+		if(vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+		{
+			const double w = d2/(d2-d6);
+			barycentric[0] = 1.0-w; barycentric[1] = 0.0; barycentric[2] = w;
+			return;
+		}
+
+		const double va = d3*d6-d5*d4;
+		if(va <= 0.0 && (d4-d3) >= 0.0 && (d5-d6) >= 0.0)
+		{
+			const double w = (d4-d3)/((d4-d3)+(d5-d6));
+			barycentric[0] = 0.0; barycentric[1] = 1.0-w; barycentric[2] = w;
+			return;
+		}
+
+		const double sum = va+vb+vc;
+		if(fabs(sum) < DBL_MIN)
+		{
+			//Degenerate triangle, all vertex and edge regions failed due to rounding
+			barycentric[0] = 1.0; barycentric[1] = 0.0; barycentric[2] = 0.0;
+			return;
+		}
+
+		const double denom = 1.0/sum;
+		const double v = vb*denom;
+		const double w = vc*denom;
+		barycentric[0] = 1.0-v-w; barycentric[1] = v; barycentric[2] = w;
+	}
+}
+
+TriangleBVH::TriangleBVH(const std::vector<double>& vertices, const std::vector<int>& triangles, const std::vector<double>& vertexNormals)
+{
+	const bool bValidNormals = vertexNormals.size() == vertices.size();
+
+	const int numTriangles = static_cast<int>(triangles.size()/3);
+	if(numTriangles == 0)
+	{
+		return;
+	}
+
+	std::vector<double> centroids(3*numTriangles);
+
+#pragma omp parallel for
+	for(int i = 0; i < numTriangles; ++i)
+	{
+		const int* face = &triangles[3*i];
+		for(size_t j = 0; j < 3; ++j)
+		{
+			centroids[3*i+j] = (vertices[3*face[0]+j]+vertices[3*face[1]+j]+vertices[3*face[2]+j])/3.0;
+		}
+	}
+
+	std::vector<int> order(numTriangles);
+	for(int i = 0; i < numTriangles; ++i)
+	{
+		order[i] = i;
+	}
+
+	m_nodes.reserve(2*(numTriangles/LEAF_SIZE+1));
+
+	//Depth-first construction, the left child is created directly after its parent
+	BuildEntry stack[MAX_STACK_SIZE];
+	size_t stackSize(0);
+
+	const BuildEntry root = {-1, 0, numTriangles};
+	stack[stackSize++] = root;
+
+	while(stackSize > 0)
+	{
+		const BuildEntry entry = stack[--stackSize];
+
+		const int nodeIndex = static_cast<int>(m_nodes.size());
+		m_nodes.push_back(Node());
+
+		//Only right children are pushed with a parent, left children follow their parent directly
+		if(entry.parent >= 0)
+		{
+			m_nodes[entry.parent].start = nodeIndex;
+		}
+
+		Node node;
+		for(size_t j = 0; j < 3; ++j)
+		{
+			node.bboxMin[j] = DBL_MAX;
+			node.bboxMax[j] = -DBL_MAX;
+		}
+
+		double centroidMin[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+		double centroidMax[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+
+		for(int i = entry.begin; i < entry.end; ++i)
+		{
+			const int* face = &triangles[3*order[i]];
+			for(size_t j = 0; j < 3; ++j)
+			{
+				for(size_t k = 0; k < 3; ++k)
+				{
+					const double value = vertices[3*face[k]+j];
+					node.bboxMin[j] = std::min(node.bboxMin[j], value);
+					node.bboxMax[j] = std::max(node.bboxMax[j], value);
+				}
+
+				centroidMin[j] = std::min(centroidMin[j], centroids[3*order[i]+j]);
+				centroidMax[j] = std::max(centroidMax[j], centroids[3*order[i]+j]);
+			}
+		}
+
+		const int count = entry.end-entry.begin;
+		if(count <= static_cast<int>(LEAF_SIZE))
+		{
+			node.start = entry.begin;
+			node.count = count;
+			m_nodes[nodeIndex] = node;
+			continue;
+		}
+
+		size_t splitDim(0);
+		for(size_t j = 1; j < 3; ++j)
+		{
+			splitDim = centroidMax[j]-centroidMin[j] > centroidMax[splitDim]-centroidMin[splitDim] ? j : splitDim;
+		}
+
+		const int mid = entry.begin+count/2;
+		std::nth_element(order.begin()+entry.begin, order.begin()+mid, order.begin()+entry.end, CentroidLess(centroids, splitDim));
+
+		node.start = -1;
+		node.count = 0;
+		m_nodes[nodeIndex] = node;
+
+		const BuildEntry right = {nodeIndex, mid, entry.end};
+		const BuildEntry left = {-1, entry.begin, mid};
+		stack[stackSize++] = right;
+		stack[stackSize++] = left;
+	}
+
+	m_trianglePositions.resize(9*numTriangles);
+	m_triangleNormals.resize(9*numTriangles, 0.0);
+	m_faceIndices.resize(numTriangles);
+
+#pragma omp parallel for
+	for(int i = 0; i < numTriangles; ++i)
+	{
+		const int faceIndex = order[i];
+		const int* face = &triangles[3*faceIndex];
+
+		m_faceIndices[i] = faceIndex;
+		for(size_t k = 0; k < 3; ++k)
+		{
+			for(size_t j = 0; j < 3; ++j)
+			{
+				m_trianglePositions[9*i+3*k+j] = vertices[3*face[k]+j];
+				if(bValidNormals)
+				{
+					m_triangleNormals[9*i+3*k+j] = vertexNormals[3*face[k]+j];
+				}
+			}
+		}
+	}
+}
+
+TriangleBVH::~TriangleBVH()
+{
+
+}
+
+bool TriangleBVH::getClosestPoint(const double* point, const double maxSqrDist, ClosestPoint& closestPoint) const
+{
+	if(point == NULL || m_nodes.empty())
+	{
+		return false;
+	}
+
+	double bestSqrDist = maxSqrDist;
+	int bestTriangle = -1;
+	double bestBarycentric[3] = {0.0, 0.0, 0.0};
+
+	int stack[MAX_STACK_SIZE];
+	size_t stackSize(0);
+	stack[stackSize++] = 0;
+
+	while(stackSize > 0)
+	{
+		const Node& node = m_nodes[stack[--stackSize]];
+		if(getSqrBoxDistance(point, node.bboxMin, node.bboxMax) >= bestSqrDist)
+		{
+			continue;
+		}
+
+		if(node.count > 0)
+		{
+			for(int i = node.start; i < node.start+node.count; ++i)
+			{
+				const double* a = &m_trianglePositions[9*i];
+				const double* b = a+3;
+				const double* c = a+6;
+
+				double barycentric[3];
+				getClosestPointOnTriangle(point, a, b, c, barycentric);
+
+				double sqrDist(0.0);
+				for(size_t j = 0; j < 3; ++j)
+				{
+					const double diff = barycentric[0]*a[j]+barycentric[1]*b[j]+barycentric[2]*c[j]-point[j];
+					sqrDist += diff*diff;
+				}
+
+				if(sqrDist < bestSqrDist)
+				{
+					bestSqrDist = sqrDist;
+					bestTriangle = i;
+					bestBarycentric[0] = barycentric[0];
+					bestBarycentric[1] = barycentric[1];
+					bestBarycentric[2] = barycentric[2];
+				}
+			}
+
+			continue;
+		}
+
+		//The left child directly follows its parent
+		const int leftChild = static_cast<int>(&node-&m_nodes[0])+1;
+		const int rightChild = node.start;
+
+		const double leftSqrDist = getSqrBoxDistance(point, m_nodes[leftChild].bboxMin, m_nodes[leftChild].bboxMax);
+		const double rightSqrDist = getSqrBoxDistance(point, m_nodes[rightChild].bboxMin, m_nodes[rightChild].bboxMax);
+
+		//Push the far child first to visit the near child next
+		const bool bLeftFirst = leftSqrDist <= rightSqrDist;
+		const int nearChild = bLeftFirst ? leftChild : rightChild;
+		const int farChild = bLeftFirst ? rightChild : leftChild;
+		const double nearSqrDist = bLeftFirst ? leftSqrDist : rightSqrDist;
+		const double farSqrDist = bLeftFirst ? rightSqrDist : leftSqrDist;
+
+		if(farSqrDist < bestSqrDist)
+		{
+			stack[stackSize++] = farChild;
+		}
+
+		if(nearSqrDist < bestSqrDist)
+		{
+			stack[stackSize++] = nearChild;
+		}
+	}
+
+	if(bestTriangle < 0)
+	{
+		return false;
+	}
+
+	closestPoint.faceIndex = m_faceIndices[bestTriangle];
+	closestPoint.sqrDist = bestSqrDist;
+
+	const double* positions = &m_trianglePositions[9*bestTriangle];
+	const double* normals = &m_triangleNormals[9*bestTriangle];
+
+	double normalLength(0.0);
+	for(size_t j = 0; j < 3; ++j)
+	{
+		closestPoint.barycentric[j] = bestBarycentric[j];
+		closestPoint.point[j] = bestBarycentric[0]*positions[j]+bestBarycentric[1]*positions[3+j]+bestBarycentric[2]*positions[6+j];
+		closestPoint.normal[j] = bestBarycentric[0]*normals[j]+bestBarycentric[1]*normals[3+j]+bestBarycentric[2]*normals[6+j];
+		normalLength += closestPoint.normal[j]*closestPoint.normal[j];
+	}
+
+	normalLength = sqrt(normalLength);
+	for(size_t j = 0; j < 3; ++j)
+	{
+		closestPoint.normal[j] = normalLength > DBL_EPSILON ? closestPoint.normal[j]/normalLength : 0.0;
+	}
+
+	return true;
+}
\ No newline at end of file
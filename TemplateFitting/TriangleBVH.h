@@ -0,0 +1,88 @@
+/*************************************************************************************************************************/
+// This source is provided for NON-COMMERCIAL RESEARCH PURPOSES only, and is provided as is WITHOUT ANY WARRANTY; 
+// without even the implied warranty of fitness for a particular purpose. The redistribution of the code is not permitted.
+//
+// If you use the source or part of it in a publication, cite the following paper:
+// 
+// A. Brunton, A. Salazar, T. Bolkart, S. Wuhrer
+// Review of Statistical Shape Spaces for 3D Data with Comparative Analysis for Human Faces.
+// Computer Vision and Image Understanding, 128:1-17, 2014
+//
+// Copyright (c) 2016 Timo Bolkart, Stefanie Wuhrer
+/*************************************************************************************************************************/
+
+#ifndef TRIANGLEBVH_H
+#define TRIANGLEBVH_H
+
+#include <vector>
+#include <stdlib.h>
+
+//! Bounding volume hierarchy over the triangles of a mesh for closest point on surface queries.
+//! The nodes are stored depth-first in one array, the left child of an inner node directly follows its parent.
+//! All queries are read-only and can be called concurrently.
+class TriangleBVH
+{
+public:
+	//! Result of a closest point query
+	struct ClosestPoint
+	{
+		//Index of the closest face within the mesh
+		int faceIndex;
+
+		//Barycentric coordinates of the closest point w.r.t. the face vertices
+		double barycentric[3];
+
+		double point[3];
+
+		//Vertex normals of the face interpolated at the closest point, normalized
+		double normal[3];
+
+		double sqrDist;
+	};
+
+	//! Maximum number of triangles per leaf
+	static const size_t LEAF_SIZE = 4;
+
+	//! Construct hierarchy for a triangle mesh.
+	//! \param vertices			3d vertices
+	//! \param triangles			3 vertex indices per triangle
+	//! \param vertexNormals		3d vertex normals
+	TriangleBVH(const std::vector<double>& vertices, const std::vector<int>& triangles, const std::vector<double>& vertexNormals);
+
+	~TriangleBVH();
+
+	size_t getNumTriangles() const { return m_faceIndices.size(); }
+
+	//! Get closest point on the mesh surface.
+	//! \param point				pointer to the xyz-coordinates of the point of request
+	//! \param maxSqrDist		only surface points with smaller squared distance are considered
+	//! \param closestPoint		closest surface point
+	//! \return true if a surface point within maxSqrDist was found
+	bool getClosestPoint(const double* point, const double maxSqrDist, ClosestPoint& closestPoint) const;
+
+private:
+	struct Node
+	{
+		double bboxMin[3];
+		double bboxMax[3];
+
+		//Leaf: first triangle and number of triangles; inner node: index of the right child and zero
+		int start;
+		int count;
+	};
+
+	TriangleBVH(const TriangleBVH& bvh);
+
+	TriangleBVH& operator=(const TriangleBVH& bvh);
+
+	std::vector<Node> m_nodes;
+
+	//Corner positions and corner normals per triangle (9 values each), in leaf order
+	std::vector<double> m_trianglePositions;
+	std::vector<double> m_triangleNormals;
+
+	//Original face index per triangle, in leaf order
+	std::vector<int> m_faceIndices;
+};
+
+#endif
\ No newline at end of file